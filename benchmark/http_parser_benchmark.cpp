@@ -0,0 +1,197 @@
+#include <server/HttpRequest.hpp>
+#include <server/HttpTokenizer.hpp>
+#include "utils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The istringstream parser HttpRequest::parse_http_request replaced, kept verbatim as the reference case.
+namespace baseline {
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string version;
+    std::map<std::string, std::string> headers;
+    std::string body;
+    std::map<std::string, std::string> query_params;
+};
+
+static std::string trim(const std::string &str) {
+    auto start = str.begin();
+    while (start != str.end() && std::isspace(*start)) ++start;
+
+    auto end = str.end();
+    do {
+        --end;
+    } while (std::distance(start, end) > 0 && std::isspace(*end));
+
+    return std::string(start, end + 1);
+}
+
+static std::map<std::string, std::string> parse_query_params(const std::string &query_str) {
+    std::map<std::string, std::string> params;
+    std::istringstream query_stream(query_str);
+    std::string pair;
+
+    while (std::getline(query_stream, pair, '&')) {
+        size_t equal_pos = pair.find('=');
+        if (equal_pos != std::string::npos) {
+            std::string key = pair.substr(0, equal_pos);
+            std::string value = pair.substr(equal_pos + 1);
+            params[key] = value;
+        } else {
+            params[pair] = "";
+        }
+    }
+
+    return params;
+}
+
+static HttpRequest parse_http_request(const std::string &raw_request) {
+    HttpRequest req;
+    std::istringstream stream(raw_request);
+    std::string line;
+
+    if (!std::getline(stream, line) || line.empty()) {
+        return req;
+    }
+
+    std::istringstream req_line(line);
+    req_line >> req.method;
+
+    std::string full_path;
+    req_line >> full_path;
+    size_t qmark = full_path.find('?');
+
+    if (qmark != std::string::npos) {
+        req.path = full_path.substr(0, qmark);
+        std::string query_string = full_path.substr(qmark + 1);
+        req.query_params = parse_query_params(query_string);
+    } else {
+        req.path = full_path;
+    }
+
+    req_line >> req.version;
+
+    while (std::getline(stream, line) && line != "\r") {
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            std::string key = trim(line.substr(0, colon));
+            std::string value = trim(line.substr(colon + 1));
+            if (!value.empty() && value.back() == '\r') {
+                value.pop_back();
+            }
+            std::string key_lower = key;
+            std::ranges::transform(key_lower, key_lower.begin(), ::tolower);
+            req.headers[key_lower] = value;
+        }
+    }
+
+    std::ostringstream body_stream;
+    while (std::getline(stream, line)) {
+        body_stream << line << "\n";
+    }
+    req.body = body_stream.str();
+    if (!req.body.empty() && req.body.back() == '\n') {
+        req.body.pop_back();
+    }
+
+    return req;
+}
+} // namespace baseline
+
+static std::string browser_request(const std::string &path, size_t cookie_bytes) {
+    std::string cookie;
+    for (size_t i = 0; cookie.size() < cookie_bytes; ++i) {
+        cookie += "_ga_" + std::to_string(i) + "=GS1.1." + std::to_string(1700000000 + i * 7919) + ".3.1.1700003600.0; ";
+    }
+    return "GET " + path + " HTTP/1.1\r\n"
+           "Host: www.example.com\r\n"
+           "Connection: keep-alive\r\n"
+           "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+           "sec-ch-ua-mobile: ?0\r\n"
+           "sec-ch-ua-platform: \"Linux\"\r\n"
+           "Upgrade-Insecure-Requests: 1\r\n"
+           "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+           "Chrome/124.0.0.0 Safari/537.36\r\n"
+           "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,"
+           "*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+           "Sec-Fetch-Site: same-origin\r\n"
+           "Sec-Fetch-Mode: navigate\r\n"
+           "Sec-Fetch-User: ?1\r\n"
+           "Sec-Fetch-Dest: document\r\n"
+           "Referer: https://www.example.com/catalog/search?q=lightweight+server&page=2\r\n"
+           "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+           "Accept-Language: en-US,en;q=0.9,uk;q=0.8\r\n"
+           "traceparent: 00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01\r\n"
+           "tracestate: congo=t61rcWkgMzE,rojo=00f067aa0ba902b7\r\n"
+           "Cookie: " + cookie + "\r\n"
+           "\r\n";
+}
+
+static const char *to_string(const HttpTokenizer::Implementation implementation) {
+    switch (implementation) {
+        case HttpTokenizer::Implementation::SCALAR:
+            return "scalar";
+        case HttpTokenizer::Implementation::SSE42:
+            return "sse4.2";
+        case HttpTokenizer::Implementation::AVX2:
+            return "avx2";
+    }
+    return "unknown";
+}
+
+template <typename Parse>
+static bool measure(const std::string &name, const char *parser, const std::string &raw, const int n, Parse parse) {
+    size_t checksum = 0;
+    auto start = get_current_time_fenced();
+    for (int i = 0; i < n; ++i) {
+        checksum += parse(raw);
+    }
+    auto end = get_current_time_fenced();
+    if (checksum == 0) {
+        std::cerr << "parser produced no headers\n";
+        return false;
+    }
+
+    const double ns = std::chrono::duration<double, std::nano>(end - start).count() / n;
+    std::cout << "| " << std::left << std::setw(19) << name << "| " << std::setw(14) << parser << "| " << std::right
+            << std::setw(5) << raw.size() << " | " << std::setw(10) << static_cast<int>(ns) << " | " << std::setw(8)
+            << static_cast<int>(static_cast<double>(raw.size()) * 1000.0 / ns) << " |\n";
+    return true;
+}
+
+int main() {
+    constexpr int N = 200000;
+    const std::vector<std::pair<std::string, std::string>> requests = {
+        {"no cookies", browser_request("/", 0)},
+        {"1 KB cookies", browser_request("/catalog/item?id=42", 1024)},
+        {"4 KB cookies", browser_request("/static/app.js", 4096)},
+    };
+
+    std::cout << "\n| Request            | Parser        | Bytes | ns/request | MB/s     |\n";
+    std::cout << "|--------------------|---------------|-------|------------|----------|\n";
+    for (const auto &[name, raw]: requests) {
+        if (!measure(name, "istringstream", raw, N,
+                     [](const std::string &r) { return baseline::parse_http_request(r).headers.size(); })) {
+            return 1;
+        }
+        for (const auto impl: {HttpTokenizer::Implementation::SCALAR, HttpTokenizer::Implementation::SSE42,
+                               HttpTokenizer::Implementation::AVX2}) {
+            if (!HttpTokenizer::is_supported(impl)) {
+                continue;
+            }
+            HttpTokenizer::set_implementation(impl);
+            if (!measure(name, to_string(impl), raw, N,
+                         [](const std::string &r) { return HttpRequest::parse_http_request(r).headers.size(); })) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <server/Threadpool.hpp>
+#include "utils.hpp"
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+
+// Stand-in for parsing a request: enough work that scheduling overhead is visible but not dominant.
+static void busy_work(std::atomic<uint64_t> &sink) {
+    uint64_t x = 88172645463325252ull;
+    for (int i = 0; i < 200; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+    sink.fetch_add(x & 1, std::memory_order_relaxed);
+}
+
+static void wait_for(const std::atomic<size_t> &done, const size_t expected) {
+    while (done.load(std::memory_order_acquire) < expected) {
+        std::this_thread::yield();
+    }
+}
+
+// One external submitter, like the acceptor handing connections to the pool.
+static double run_injected(const size_t threads, const size_t tasks) {
+    Threadpool pool(threads);
+    std::atomic<size_t> done{0};
+    std::atomic<uint64_t> sink{0};
+    const auto start = get_current_time_fenced();
+    for (size_t i = 0; i < tasks; ++i) {
+        pool.submit([&] {
+            busy_work(sink);
+            done.fetch_add(1, std::memory_order_release);
+        });
+    }
+    wait_for(done, tasks);
+    const auto end = get_current_time_fenced();
+    return static_cast<double>(tasks) / std::chrono::duration<double>(end - start).count();
+}
+
+// Every task fans out from a worker, which exercises the local deques and stealing.
+static double run_nested(const size_t threads, const size_t tasks) {
+    constexpr size_t FAN_OUT = 64;
+    Threadpool pool(threads);
+    std::atomic<size_t> done{0};
+    std::atomic<uint64_t> sink{0};
+    const auto start = get_current_time_fenced();
+    for (size_t i = 0; i < tasks / FAN_OUT; ++i) {
+        pool.submit([&] {
+            for (size_t j = 0; j < FAN_OUT; ++j) {
+                pool.submit([&] {
+                    busy_work(sink);
+                    done.fetch_add(1, std::memory_order_release);
+                });
+            }
+        });
+    }
+    wait_for(done, tasks / FAN_OUT * FAN_OUT);
+    const auto end = get_current_time_fenced();
+    return static_cast<double>(tasks) / std::chrono::duration<double>(end - start).count();
+}
+
+int main() {
+    constexpr size_t TASKS = 1 << 20;
+    std::cout << "\n| Threads | Injected (Mtasks/s) | Nested (Mtasks/s) |\n";
+    std::cout << "|---------|---------------------|-------------------|\n";
+    for (size_t threads = 1; threads <= 64; threads *= 2) {
+        const double injected = run_injected(threads, TASKS);
+        const double nested = run_nested(threads, TASKS);
+        std::cout << "| " << std::setw(7) << threads << " | " << std::setw(19) << std::fixed << std::setprecision(2)
+                << injected / 1e6 << " | " << std::setw(17) << nested / 1e6 << " |\n";
+    }
+    return 0;
+}
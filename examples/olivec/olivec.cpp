@@ -11,7 +11,6 @@ using json = nlohmann::json;
 struct ClientInfo {
     std::string id;
     std::string name = "Anonymous";
-    WebSocket *ws = nullptr;
 };
 
 std::unordered_map<int, ClientInfo> clients;
@@ -25,43 +24,27 @@ std::string generate_uuid() {
     return {str};
 }
 
-void broadcast(const json &msg, int exclude_fd = -1) {
-    const std::string raw = msg.dump();
-
-    std::vector<WebSocket *> recipients;
-    {
-        for (const auto &[fd, client]: clients) {
-            if (fd != exclude_fd && client.ws) {
-                recipients.push_back(client.ws);
-            }
-        }
-    }
-
-    for (WebSocket *ws : recipients) {
-        try {
-            ws->send(raw, WebSocket::OpCode::TEXT);
-        } catch (const std::exception &e) {
-            std::cerr << "[Broadcast Error] " << e.what() << "\n";
-        }
-    }
+void broadcast(WSApplication &websockets, const json &msg, const WebSocket *exclude = nullptr) {
+    websockets.publish("canvas", msg.dump(), WebSocket::OpCode::TEXT, exclude);
 }
 
 int main() {
     const int port = 9000;
     const std::filesystem::path base_assets_path = std::filesystem::absolute("public");
 
-    WebServer server{{"127.0.0.1", port}};
+    WebServer server{{.host = "127.0.0.1", .port = port, .ws_app = {.websocket = {.deflate = {.enabled = true}}}}};
     server.get("/", [base_assets_path](const HttpRequest &req) {
         return HttpResponse::ServeStatic(base_assets_path, req, "/");
     });
 
-    server.on_open([](WebSocket &ws) {
+    server.on_open([&server](WebSocket &ws) {
         int fd = ws.get_fd();
         std::string uuid = generate_uuid();
-        clients[fd] = ClientInfo{uuid, "Anonymous", &ws};
+        clients[fd] = ClientInfo{uuid, "Anonymous"};
+        server.websockets().subscribe(ws, "canvas");
     });
 
-    server.on_message([](WebSocket &ws, std::string_view data, WebSocket::OpCode opCode) {
+    server.on_message([&server](WebSocket &ws, std::string_view data, WebSocket::OpCode opCode) {
         int fd = ws.get_fd();
         json msg;
         try {
@@ -93,7 +76,7 @@ int main() {
                 {"size", msg["size"]}
             };
             drawHistory.push_back(stroke);
-            broadcast(stroke, fd);
+            broadcast(server.websockets(), stroke, &ws);
         } else if (msg["type"] == "cursor") {
             json cursor = {
                 {"type", "cursor"},
@@ -102,10 +85,10 @@ int main() {
                 {"userId", client.id},
                 {"name", client.name}
             };
-            broadcast(cursor, fd);
+            broadcast(server.websockets(), cursor, &ws);
         } else if (msg["type"] == "clear") {
             drawHistory.clear();
-            broadcast({{"type", "clear"}});
+            broadcast(server.websockets(), {{"type", "clear"}});
         }
     });
 
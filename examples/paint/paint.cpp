@@ -12,32 +12,15 @@ struct ClientInfo {
 
 int main() {
     auto port = 9000;
-    WebServer server{{"127.0.0.1", port}};
+    // Clients that offer permessage-deflate get it.
+    WebServer server{{.host = "127.0.0.1", .port = port, .ws_app = {.websocket = {.deflate = {.enabled = true}}}}};
     const std::filesystem::path base_assets_path = std::filesystem::absolute("public");
 
     std::unordered_map<int, ClientInfo> clients;
-    std::unordered_map<int, WebSocket *> ws_connections;
     std::vector<nlohmann::json> drawHistory;
 
-    auto broadcast = [&](const nlohmann::json &msg, int exclude_fd = -1) {
-        const std::string data = msg.dump();
-        std::vector<int> disconnected_fds;
-
-        for (auto &[fd, ws]: ws_connections) {
-            if (fd != exclude_fd) {
-                try {
-                    ws->send(data, WebSocket::OpCode::TEXT);
-                } catch (const std::exception &e) {
-                    std::cerr << "Error sending to fd " << fd << ": " << e.what() << std::endl;
-                    disconnected_fds.push_back(fd);
-                }
-            }
-        }
-
-        for (auto fd: disconnected_fds) {
-            clients.erase(fd);
-            ws_connections.erase(fd);
-        }
+    auto broadcast = [&](const nlohmann::json &msg, const WebSocket *exclude = nullptr) {
+        server.websockets().publish("canvas", msg.dump(), WebSocket::OpCode::TEXT, exclude);
     };
 
     server.get("/", [base_assets_path](const HttpRequest &req) {
@@ -47,7 +30,7 @@ int main() {
     server.on_open([&](WebSocket &ws) {
         int fd = ws.get_fd();
         clients[fd] = {"", "Anonymous"};
-        ws_connections[fd] = &ws;
+        server.websockets().subscribe(ws, "canvas");
         std::cout << "[WS] Connected fd: " << fd << std::endl;
     });
 
@@ -75,7 +58,7 @@ int main() {
                 {"size", json_msg["size"]}
             };
             drawHistory.push_back(stroke);
-            broadcast(stroke, fd);
+            broadcast(stroke, &ws);
         } else if (type == "cursor") {
             nlohmann::json cursor = {
                 {"type", "cursor"},
@@ -84,7 +67,7 @@ int main() {
                 {"x", json_msg["x"]},
                 {"y", json_msg["y"]}
             };
-            broadcast(cursor, fd);
+            broadcast(cursor, &ws);
         } else if (type == "clear") {
             drawHistory.clear();
             broadcast({{"type", "clear"}});
@@ -94,7 +77,6 @@ int main() {
     server.on_close([&](WebSocket &ws) {
         int fd = ws.get_fd();
         clients.erase(fd);
-        ws_connections.erase(fd);
         std::cout << "[WS] Disconnected fd: " << fd << std::endl;
     });
 
@@ -12,7 +12,7 @@ int main() {
     server.post("/test", [](const HttpRequest &req) {
         std::cout << "[POST /test] Received body:\n" << req.body << std::endl;
 
-        return HttpResponse::Text("Received:\n" + req.body, 200);
+        return HttpResponse::Text("Received:\n" + std::string{req.body}, 200);
     });
     server.on_open([](WebSocket &ws) { std::cout << "[WS] Connection opened" << std::endl; })
             .on_message([](WebSocket &ws, std::string_view msg, WebSocket::OpCode opCode) {
@@ -0,0 +1,126 @@
+#ifndef EVENTLOOP_HPP
+#define EVENTLOOP_HPP
+
+#include <server/SocketListener.hpp>
+#include <server/Threadpool.hpp>
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// Drives the awaitables of coroutine handlers: one epoll loop for socket readiness plus a timerfd backed by a
+// deadline heap. Woken coroutines resume on the thread pool (inline on the loop thread when the pool sheds them),
+// so a suspended handler holds no thread while it waits.
+class EventLoop {
+public:
+  struct Parameters {
+    SocketListener::Parameters listener{};
+  };
+
+  class ReadinessAwaiter {
+  public:
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) const { loop_.watch(fd_, events_, handle); }
+    void await_resume() const noexcept {}
+
+  private:
+    friend class EventLoop;
+    ReadinessAwaiter(EventLoop &loop, const int fd, const uint32_t events) : loop_{loop}, fd_{fd}, events_{events} {}
+
+    EventLoop &loop_;
+    int fd_;
+    uint32_t events_;
+  };
+
+  class TimerAwaiter {
+  public:
+    bool await_ready() const noexcept { return deadline_ <= std::chrono::steady_clock::now(); }
+    void await_suspend(std::coroutine_handle<> handle) const { loop_.schedule(deadline_, handle); }
+    void await_resume() const noexcept {}
+
+  private:
+    friend class EventLoop;
+    TimerAwaiter(EventLoop &loop, const std::chrono::steady_clock::time_point deadline)
+        : loop_{loop}, deadline_{deadline} {}
+
+    EventLoop &loop_;
+    std::chrono::steady_clock::time_point deadline_;
+  };
+
+  class OffloadAwaiter {
+  public:
+    bool await_ready() const noexcept { return pool_ == nullptr; }
+    // Does not suspend when the pool sheds the continuation; the coroutine then carries on where it is.
+    bool await_suspend(std::coroutine_handle<> handle) const {
+      return pool_->submit([handle] { handle.resume(); });
+    }
+    void await_resume() const noexcept {}
+
+  private:
+    friend class EventLoop;
+    explicit OffloadAwaiter(Threadpool *pool) : pool_{pool} {}
+
+    Threadpool *pool_;
+  };
+
+  explicit EventLoop(Parameters parameters, Threadpool *pool = nullptr);
+  ~EventLoop();
+
+  EventLoop(const EventLoop &) = delete;
+  EventLoop &operator=(const EventLoop &) = delete;
+
+  // Runs the loop on the calling thread until stop().
+  void run();
+
+  void stop();
+
+  // Suspend until `fd` is readable or writable, or has hung up. The fd is switched to non-blocking mode and may
+  // only have one waiting coroutine at a time.
+  [[nodiscard]] ReadinessAwaiter readable(int fd);
+  [[nodiscard]] ReadinessAwaiter writable(int fd);
+
+  [[nodiscard]] TimerAwaiter sleep_for(std::chrono::steady_clock::duration duration);
+  [[nodiscard]] TimerAwaiter sleep_until(std::chrono::steady_clock::time_point deadline);
+
+  // Moves the rest of the coroutine onto a pool worker, so blocking calls stay off the event loop. A no-op
+  // without a pool.
+  [[nodiscard]] OffloadAwaiter offload();
+
+private:
+  struct Timer {
+    std::chrono::steady_clock::time_point deadline;
+    uint64_t sequence;
+    std::coroutine_handle<> handle;
+
+    bool operator>(const Timer &other) const {
+      return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+    }
+  };
+
+  void watch(int fd, uint32_t events, std::coroutine_handle<> handle);
+
+  void schedule(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> handle);
+
+  void on_event(int fd);
+
+  void on_timer();
+
+  void arm_timer(std::chrono::steady_clock::time_point deadline) const;
+
+  void resume(std::coroutine_handle<> handle) const;
+
+  Threadpool *pool_;
+  int timer_fd_{-1};
+  SocketListener listener_;
+
+  std::mutex mtx_;
+  std::unordered_map<int, std::coroutine_handle<>> waiters_;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers_;
+  uint64_t next_sequence_{0};
+};
+
+#endif // EVENTLOOP_HPP
@@ -0,0 +1,34 @@
+#ifndef HTTPCOMPRESSION_HPP
+#define HTTPCOMPRESSION_HPP
+
+#include <server/HttpRequest.hpp>
+#include <server/HttpResponse.hpp>
+#include <string>
+#include <string_view>
+
+class HttpCompression {
+public:
+  struct Parameters {
+    bool enabled{false};
+    // Smaller bodies are sent as is; compressing them costs more CPU than it saves on the wire.
+    size_t min_size{1024};
+    // zlib level, 1 (fastest) to 9 (smallest).
+    int level{6};
+  };
+
+  // Whether `coding` has a non-zero q-value in an Accept-Encoding header value.
+  static bool accepts(std::string_view accept_encoding, std::string_view coding);
+
+  static bool is_compressible(std::string_view content_type);
+
+  // Gzips an in-memory response body when the client accepts it, setting Content-Encoding and Vary.
+  // Returns false and leaves the body alone when the response does not qualify or zlib is unavailable.
+  static bool compress(HttpResponse &response, const HttpRequest &request, const Parameters &parameters);
+
+  static bool is_available();
+
+  // Throws std::runtime_error when built without zlib.
+  static std::string gzip(std::string_view data, int level);
+};
+
+#endif // HTTPCOMPRESSION_HPP
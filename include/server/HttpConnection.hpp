@@ -0,0 +1,90 @@
+#ifndef HTTPCONNECTION_HPP
+#define HTTPCONNECTION_HPP
+
+#include <cstddef>
+#include <server/HttpResponse.hpp>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+class HttpConnection {
+public:
+  enum class ReadStatus { COMPLETE, INCOMPLETE, CLOSED, BAD_REQUEST, HEADERS_TOO_LARGE, BODY_TOO_LARGE };
+  // PENDING: the socket is full and the rest of the response waits for flush().
+  enum class SendStatus { COMPLETE, PENDING, FAILED };
+
+  struct Parameters {
+    size_t max_header_size{16 * 1024};
+    size_t max_body_size{16 * 1024 * 1024};
+  };
+
+  explicit HttpConnection(int fd);
+
+  int get_fd() const;
+
+  // Reads from the socket until one whole request is buffered, the socket would block or a limit is hit.
+  ReadStatus read_request(const Parameters &parameters);
+
+  // Hands the read buffer itself over as the framed request (with a de-chunked body); only pipelined bytes
+  // that follow it are copied into a fresh buffer.
+  std::string take_request();
+
+  [[nodiscard]] bool has_buffered_data() const;
+
+  // Sends the serialized head and the body in one sendmsg (file bodies follow the head via sendfile) without ever
+  // waiting: on EAGAIN the connection keeps the response and where it stopped, and flush() carries on once the
+  // socket is writable again.
+  SendStatus send_response(HttpResponse response);
+
+  // Writes as much of the pending response as the socket takes.
+  SendStatus flush();
+
+  [[nodiscard]] bool has_pending_output() const;
+
+  size_t requests_served{0};
+  bool registered{false};
+  // Whether the connection is closed once the pending response is out.
+  bool close_after_send{false};
+
+private:
+  ReadStatus frame_request(const Parameters &parameters);
+
+  ReadStatus frame_chunked_body(const Parameters &parameters);
+
+  void reset_framing();
+
+  // A run of bytes, or a file range sent with sendfile when `file_fd` is set. Views point into head_buffer_
+  // and pending_response_.
+  struct Segment {
+    std::string_view data{};
+    int file_fd{-1};
+    off_t offset{0};
+    size_t length{0};
+  };
+
+  SendStatus send_data();
+
+  SendStatus send_file(Segment &segment);
+
+  int fd_;
+  std::string buffer_;
+  std::string head_buffer_;
+  HttpResponse pending_response_;
+  std::vector<Segment> segments_;
+  size_t next_segment_{0};
+  size_t scanned_{0};
+  size_t header_end_{std::string::npos};
+  size_t body_end_{0};
+  size_t chunk_pos_{0};
+  size_t request_end_{0};
+  bool chunked_{false};
+  bool complete_{false};
+
+  static constexpr size_t READ_CHUNK_SIZE = 16 * 1024;
+  static constexpr size_t MAX_READ_SIZE = 1024 * 1024;
+  static constexpr size_t MAX_CHUNK_LINE_SIZE = 1024;
+  static constexpr size_t MAX_IOV = 64;
+};
+
+#endif // HTTPCONNECTION_HPP
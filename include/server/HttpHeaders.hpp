@@ -0,0 +1,173 @@
+#ifndef HTTPHEADERS_HPP
+#define HTTPHEADERS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+enum class HttpHeader : uint8_t {
+  ACCEPT,
+  ACCEPT_ENCODING,
+  ACCEPT_RANGES,
+  CACHE_CONTROL,
+  CONNECTION,
+  CONTENT_ENCODING,
+  CONTENT_LENGTH,
+  CONTENT_RANGE,
+  CONTENT_TYPE,
+  COOKIE,
+  DATE,
+  ETAG,
+  HOST,
+  IF_MODIFIED_SINCE,
+  IF_NONE_MATCH,
+  IF_RANGE,
+  KEEP_ALIVE,
+  LAST_MODIFIED,
+  LOCATION,
+  RANGE,
+  RETRY_AFTER,
+  SEC_WEBSOCKET_ACCEPT,
+  SEC_WEBSOCKET_EXTENSIONS,
+  SEC_WEBSOCKET_KEY,
+  SEC_WEBSOCKET_VERSION,
+  TRANSFER_ENCODING,
+  UPGRADE,
+  USER_AGENT,
+  VARY,
+  COUNT,
+  UNKNOWN = COUNT
+};
+
+std::string_view http_header_name(HttpHeader header);
+
+// Case-insensitive match against the well-known header names, UNKNOWN for anything else.
+HttpHeader http_header_id(std::string_view name);
+
+bool ascii_iequals(std::string_view lhs, std::string_view rhs);
+
+// Insertion-ordered header list stored inline for the first InlineCapacity entries. Well-known headers get a
+// slot index so lookups by HttpHeader (or by a well-known name) never scan the list.
+template <typename String, size_t InlineCapacity> class BasicHttpHeaders {
+public:
+  using value_type = std::pair<String, String>;
+  using const_iterator = const value_type *;
+
+  [[nodiscard]] const_iterator begin() const { return data(); }
+
+  [[nodiscard]] const_iterator end() const { return data() + size_; }
+
+  [[nodiscard]] size_t size() const { return size_; }
+
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+
+  [[nodiscard]] const_iterator find(const HttpHeader header) const {
+    if (header == HttpHeader::UNKNOWN) {
+      return end();
+    }
+    const uint16_t slot = slots_[static_cast<size_t>(header)];
+    return slot == 0 ? end() : data() + slot - 1;
+  }
+
+  [[nodiscard]] const_iterator find(const std::string_view name) const {
+    if (const HttpHeader header = http_header_id(name); header != HttpHeader::UNKNOWN) {
+      return find(header);
+    }
+    for (auto it = begin(); it != end(); ++it) {
+      if (ascii_iequals(it->first, name)) {
+        return it;
+      }
+    }
+    return end();
+  }
+
+  template <typename Key> [[nodiscard]] bool contains(const Key &key) const { return find(key) != end(); }
+
+  template <typename Key> [[nodiscard]] const String &at(const Key &key) const {
+    const auto it = find(key);
+    if (it == end()) {
+      throw std::out_of_range("Header not found");
+    }
+    return it->second;
+  }
+
+  void set(const std::string_view name, const std::string_view value) {
+    const HttpHeader header = http_header_id(name);
+    const auto it = header != HttpHeader::UNKNOWN ? find(header) : find(name);
+    if (it != end()) {
+      data()[it - begin()].second = String{value};
+      return;
+    }
+    push_back(value_type{String{name}, String{value}});
+    if (header != HttpHeader::UNKNOWN) {
+      slots_[static_cast<size_t>(header)] = static_cast<uint16_t>(size_);
+    }
+  }
+
+  void set(const HttpHeader header, const std::string_view value) { set(http_header_name(header), value); }
+
+  template <typename Key> bool erase(const Key &key) {
+    const auto it = find(key);
+    if (it == end()) {
+      return false;
+    }
+    const auto index = static_cast<uint16_t>(it - begin());
+    value_type *entries = data();
+    for (size_t i = index; i + 1 < size_; ++i) {
+      entries[i] = std::move(entries[i + 1]);
+    }
+    --size_;
+    if (on_heap_) {
+      heap_.pop_back();
+    } else {
+      inline_[size_] = value_type{};
+    }
+    for (auto &slot : slots_) {
+      if (slot == index + 1) {
+        slot = 0;
+      } else if (slot > index + 1) {
+        --slot;
+      }
+    }
+    return true;
+  }
+
+  void clear() { *this = BasicHttpHeaders{}; }
+
+private:
+  value_type *data() { return on_heap_ ? heap_.data() : inline_.data(); }
+
+  [[nodiscard]] const value_type *data() const { return on_heap_ ? heap_.data() : inline_.data(); }
+
+  void push_back(value_type entry) {
+    if (!on_heap_ && size_ < InlineCapacity) {
+      inline_[size_++] = std::move(entry);
+      return;
+    }
+    if (!on_heap_) {
+      heap_.reserve(InlineCapacity * 2);
+      for (size_t i = 0; i < size_; ++i) {
+        heap_.push_back(std::move(inline_[i]));
+      }
+      on_heap_ = true;
+    }
+    heap_.push_back(std::move(entry));
+    ++size_;
+  }
+
+  std::array<value_type, InlineCapacity> inline_{};
+  std::vector<value_type> heap_;
+  size_t size_{0};
+  bool on_heap_{false};
+  std::array<uint16_t, static_cast<size_t>(HttpHeader::COUNT)> slots_{};
+};
+
+using HttpRequestHeaders = BasicHttpHeaders<std::string_view, 32>;
+using HttpResponseHeaders = BasicHttpHeaders<std::string, 12>;
+
+#endif // HTTPHEADERS_HPP
@@ -2,7 +2,11 @@
 #define HTTPREQUEST_HPP
 
 #include <string>
+#include <string_view>
 #include <map>
+#include <memory>
+#include <vector>
+#include <server/HttpHeaders.hpp>
 
 struct HttpRequest {
     enum class HttpMethod {
@@ -16,21 +20,33 @@ struct HttpRequest {
         HTTP_UNKNOWN
     };
 
-
-    HttpMethod method;
-    std::string path;
-    std::string version;
-    std::map<std::string, std::string> headers;
-    std::string body;
-    std::map<std::string, std::string> query_params;
-
-    static HttpMethod parse_http_method(const std::string& method_str);
+    // All views point into the raw request buffer, which is shared by every copy of the request.
+    // Copy a field into an std::string only when it has to outlive the request.
+    HttpMethod method{HttpMethod::HTTP_UNKNOWN};
+    std::string_view path;
+    std::string_view version;
+    HttpRequestHeaders headers;
+    std::string_view body;
+    std::map<std::string_view, std::string_view> query_params;
+    // Filled by the router from ":name" and "*name" route segments.
+    std::vector<std::pair<std::string_view, std::string_view>> path_params;
+
+    static HttpMethod parse_http_method(std::string_view method_str);
     static std::string http_method_to_string(HttpMethod method);
 
-    static HttpRequest parse_http_request(const std::string &raw_request);
+    static HttpRequest parse_http_request(std::string raw_request);
     [[nodiscard]] bool is_websocket_upgrade() const;
 
     [[nodiscard]] std::string get_websocket_key() const;
+
+    [[nodiscard]] bool keep_alive() const;
+
+    [[nodiscard]] std::string_view raw() const;
+
+    [[nodiscard]] std::string_view path_param(std::string_view name) const;
+
+private:
+    std::shared_ptr<const std::string> buffer_;
 };
 
 
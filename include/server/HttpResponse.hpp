@@ -2,29 +2,102 @@
 #define HTTPRESPONSE_HPP
 
 #include <string>
-#include <map>
 #include <filesystem>
+#include <memory>
+#include <optional>
 #include <server/HttpRequest.hpp>
+#include <sys/types.h>
+#include <vector>
+
+class StaticAssetCache;
+struct stat;
+
+struct CacheControlRule {
+    std::string prefix;
+    std::string value;
+};
+
+struct ServeStaticOptions {
+    // When set, hot assets are answered from memory instead of the filesystem.
+    StaticAssetCache* cache{nullptr};
+    // The rule with the longest prefix matching the request path sets Cache-Control.
+    std::vector<CacheControlRule> cache_control;
+    // Serve "file.br" / "file.gz" next to "file" when present and accepted by the client.
+    bool precompressed{true};
+};
 
 struct HttpResponse {
+    // Owns an open file descriptor; shared by every copy of a file-backed response.
+    class File {
+    public:
+        explicit File(int fd);
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+        ~File();
+
+        [[nodiscard]] int get_fd() const;
+
+    private:
+        int fd_;
+    };
+
+    // A byte range of a file that the write path sends with sendfile(2) instead of `body`.
+    struct FileBody {
+        std::shared_ptr<const File> file;
+        off_t offset{0};
+        size_t length{0};
+    };
+
     std::string version = "HTTP/1.1";
     int status_code = 200;
     std::string status_text = "OK";
-    std::map<std::string, std::string> headers;
+    HttpResponseHeaders headers;
     std::string body;
+    // Immutable body shared with a cache; takes precedence over `body` when set.
+    std::shared_ptr<const std::string> shared_body;
+    // Raw "Name: value\r\n" lines emitted after `headers`.
+    std::shared_ptr<const std::string> preserialized_headers;
+    std::optional<FileBody> file_body;
+
+    // One part of a multipart body: `data` is written first, followed by the optional file range.
+    struct BodyPart {
+        std::string data;
+        std::optional<FileBody> file;
+    };
+
+    std::vector<BodyPart> body_parts;
+
+    [[nodiscard]] size_t content_length() const;
+
+    [[nodiscard]] std::string_view body_data() const;
 
     [[nodiscard]] std::string to_string() const;
 
+    // Appends the status line and headers (everything but the body) to `out`.
+    void serialize_head(std::string& out) const;
+
     void set_header(const std::string& key, const std::string& value);
 
+    // Narrows a 200 response to the ranges requested by `req` (206, or 416 if none is satisfiable), honouring
+    // If-Range against the response's ETag and Last-Modified. File-backed bodies stay on the sendfile path.
+    void apply_range(const HttpRequest& req);
+
     static HttpResponse Text(const std::string& body, int status = 200);
     static HttpResponse Json(const std::string& json_body, int status = 200);
     static HttpResponse NotFound(const std::string& message = "404 Not Found");
+    static HttpResponse Error(int status, const std::string& status_text);
     static HttpResponse Redirect(const std::string& location, bool permanent = false);
     static HttpResponse Html(const std::string& html, int status = 200);
     static HttpResponse FromFile(const std::string& file_path, const std::string& content_type = "application/octet-stream");
-    static HttpResponse ServeStatic(const std::filesystem::path& base_path, const HttpRequest& req, const std::string& route_prefix = "/assets");
-    static HttpResponse WebSocketSwitchingProtocols(const std::string& websocket_key);
+    static HttpResponse ServeStatic(const std::filesystem::path& base_path, const HttpRequest& req, const std::string& route_prefix = "/assets",
+                                    const ServeStaticOptions& options = {});
+    // `extensions` is the agreed Sec-WebSocket-Extensions value, left out when empty.
+    static HttpResponse WebSocketSwitchingProtocols(const std::string& websocket_key, const std::string& extensions = "");
+
+    // Strong validator derived from inode, size and modification time.
+    static std::string file_etag(const struct stat& st);
+    static std::string http_date(time_t time);
+    static std::optional<time_t> parse_http_date(std::string_view date);
 
 
 };
@@ -0,0 +1,24 @@
+#ifndef HTTPTOKENIZER_HPP
+#define HTTPTOKENIZER_HPP
+
+#include <cstddef>
+#include <string_view>
+
+class HttpTokenizer {
+public:
+  enum class Implementation { SCALAR, SSE42, AVX2 };
+
+  // Position of the first byte in str[pos..] that equals one of `delimiters` (at most 16), or npos.
+  static size_t find_first_of(std::string_view str, std::string_view delimiters, size_t pos = 0);
+
+  static Implementation implementation();
+
+  // Overrides the CPU-detected implementation, e.g. to compare them in benchmarks.
+  static void set_implementation(Implementation implementation);
+
+  static bool is_supported(Implementation implementation);
+
+  static constexpr size_t MAX_DELIMITERS = 16;
+};
+
+#endif // HTTPTOKENIZER_HPP
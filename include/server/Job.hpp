@@ -0,0 +1,123 @@
+#ifndef JOB_HPP
+#define JOB_HPP
+
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move-only replacement for std::function<void()> used by Threadpool. Callables up to INLINE_SIZE bytes that are
+// nothrow-movable live in the object itself, so submitting a typical lambda never touches the heap; larger ones
+// fall back to a single allocation. Move-only captures such as std::unique_ptr are accepted.
+class Job {
+public:
+  static constexpr size_t INLINE_SIZE = 64;
+
+  Job() noexcept = default;
+
+  Job(std::nullptr_t) noexcept {}
+
+  template <typename F>
+    requires(!std::same_as<std::remove_cvref_t<F>, Job> && std::invocable<std::decay_t<F> &>)
+  Job(F &&f) {
+    using Fn = std::decay_t<F>;
+    if constexpr (fits_inline<Fn>) {
+      ::new (static_cast<void *>(storage_)) Fn(std::forward<F>(f));
+      ops_ = &inline_ops<Fn>;
+    } else {
+      *reinterpret_cast<Fn **>(storage_) = new Fn(std::forward<F>(f));
+      ops_ = &heap_ops<Fn>;
+    }
+  }
+
+  Job(Job &&other) noexcept { take(other); }
+
+  Job &operator=(Job &&other) noexcept {
+    if (this != &other) {
+      reset();
+      take(other);
+    }
+    return *this;
+  }
+
+  Job &operator=(std::nullptr_t) noexcept {
+    reset();
+    return *this;
+  }
+
+  Job(const Job &) = delete;
+  Job &operator=(const Job &) = delete;
+
+  ~Job() { reset(); }
+
+  void operator()() {
+    if (!ops_) {
+      throw std::bad_function_call();
+    }
+    ops_->invoke(storage_);
+  }
+
+  explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+  [[nodiscard]] bool is_inline() const noexcept { return ops_ && ops_->is_inline; }
+
+private:
+  struct Ops {
+    void (*invoke)(void *storage);
+    // Move-constructs into dst and destroys src; nullptr when copying the bytes is enough.
+    void (*relocate)(void *dst, void *src) noexcept;
+    void (*destroy)(void *storage) noexcept;
+    bool is_inline;
+  };
+
+  template <typename Fn>
+  static constexpr bool fits_inline = sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t) &&
+                                      std::is_nothrow_move_constructible_v<Fn>;
+
+  template <typename Fn> static void relocate_inline(void *dst, void *src) noexcept {
+    Fn *from = std::launder(static_cast<Fn *>(src));
+    ::new (dst) Fn(std::move(*from));
+    from->~Fn();
+  }
+
+  template <typename Fn>
+  static constexpr Ops inline_ops{
+      [](void *storage) { (*std::launder(static_cast<Fn *>(storage)))(); },
+      std::is_trivially_copyable_v<Fn> ? nullptr : &relocate_inline<Fn>,
+      [](void *storage) noexcept { std::launder(static_cast<Fn *>(storage))->~Fn(); },
+      true,
+  };
+
+  template <typename Fn>
+  static constexpr Ops heap_ops{
+      [](void *storage) { (**static_cast<Fn **>(storage))(); },
+      nullptr,
+      [](void *storage) noexcept { delete *static_cast<Fn **>(storage); },
+      false,
+  };
+
+  void take(Job &other) noexcept {
+    if (other.ops_) {
+      if (other.ops_->relocate) {
+        other.ops_->relocate(storage_, other.storage_);
+      } else {
+        std::memcpy(storage_, other.storage_, INLINE_SIZE);
+      }
+      ops_ = std::exchange(other.ops_, nullptr);
+    }
+  }
+
+  void reset() noexcept {
+    if (ops_) {
+      std::exchange(ops_, nullptr)->destroy(storage_);
+    }
+  }
+
+  alignas(std::max_align_t) unsigned char storage_[INLINE_SIZE];
+  const Ops *ops_{nullptr};
+};
+
+#endif // JOB_HPP
@@ -0,0 +1,68 @@
+#ifndef ROUTER_HPP
+#define ROUTER_HPP
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <server/HttpRequest.hpp>
+#include <server/HttpResponse.hpp>
+#include <server/Task.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Compressed radix tree per HTTP method. Routes are made of static text, ":name" segments that capture up to the
+// next '/', and a trailing "*name" that captures the rest of the path. Lookup prefers static > param > wildcard
+// and falls back to the longest registered route that is a prefix of the path, so "/" still serves "/app.js".
+class Router {
+public:
+  using Handler = std::function<HttpResponse(const HttpRequest &)>;
+  using AsyncHandler = std::function<Task<HttpResponse>(const HttpRequest &)>;
+
+  // Exactly one of the two handlers is set.
+  struct Route {
+    Handler handler;
+    AsyncHandler async_handler;
+
+    explicit operator bool() const { return handler || async_handler; }
+  };
+
+  void add(HttpRequest::HttpMethod method, std::string_view route, Handler handler);
+  void add(HttpRequest::HttpMethod method, std::string_view route, AsyncHandler handler);
+
+  // Resolves the route for req.method and req.path and fills req.path_params; nullptr when nothing matches.
+  const Route *match(HttpRequest &req) const;
+
+private:
+  using Params = std::vector<std::pair<std::string_view, std::string_view>>;
+
+  struct Node {
+    std::string prefix;
+    std::string indices;
+    std::vector<std::unique_ptr<Node>> children;
+    std::unique_ptr<Node> param_child;
+    std::string param_name;
+    std::unique_ptr<Node> wildcard_child;
+    std::string wildcard_name;
+    Route target;
+  };
+
+  struct Candidate {
+    const Route *target{nullptr};
+    size_t consumed{0};
+    Params params;
+  };
+
+  void add_route(HttpRequest::HttpMethod method, std::string_view route, Route target);
+
+  static void insert(Node &node, std::string_view route, Route target);
+
+  static Node &static_child(Node &node, std::string_view label);
+
+  static const Route *match(const Node &node, std::string_view path, size_t consumed, Params &params,
+                            Candidate &best);
+
+  std::array<Node, static_cast<size_t>(HttpRequest::HttpMethod::HTTP_UNKNOWN)> roots_;
+};
+
+#endif // ROUTER_HPP
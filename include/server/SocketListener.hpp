@@ -6,6 +6,7 @@
 #include <string.h>
 #include <sys/epoll.h>
 #include <unistd.h>
+#include <atomic>
 #include <functional>
 #include <stdexcept>
 #include <unordered_map>
@@ -26,6 +27,8 @@ public:
 
   void add_socket(int fd, uint32_t events = EPOLLIN | EPOLLET);
 
+  void modify_socket(int fd, uint32_t events) const;
+
   void remove_socket(int fd) const;
 
   void run();
@@ -39,7 +42,8 @@ private:
   int epoll_fd_{-1};
   std::vector<epoll_event> events_;
   Callback callback_;
-  bool running_{false};
+  // Sticky, so a stop() that lands before run() has started is not lost.
+  std::atomic<bool> stopped_{false};
 };
 
 #endif // SOCKETLISTENER_HPP
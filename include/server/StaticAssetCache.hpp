@@ -0,0 +1,101 @@
+#ifndef STATICASSETCACHE_HPP
+#define STATICASSETCACHE_HPP
+
+#include <atomic>
+#include <ctime>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Opt-in cache for HttpResponse::ServeStatic. Assets are stored by canonical path together with their MIME type
+// and pre-serialized headers, and are also reachable through the (base path, request path) pair that first
+// resolved them, so a hit needs no filesystem calls at all. Entries are evicted least-recently-used once the
+// memory budget is exceeded and dropped as soon as inotify reports a change to the file or its directory.
+class StaticAssetCache {
+public:
+  struct Parameters {
+    size_t memory_budget{64 * 1024 * 1024};
+    // Larger files are not cached and keep going through the sendfile path.
+    size_t max_asset_size{4 * 1024 * 1024};
+    int poll_timeout{500};
+  };
+
+  struct Asset {
+    std::filesystem::path path;
+    std::shared_ptr<const std::string> content;
+    std::string mime;
+    std::string content_encoding;
+    std::string etag;
+    time_t last_modified{0};
+    std::shared_ptr<const std::string> headers;
+  };
+
+  explicit StaticAssetCache(Parameters parameters);
+
+  StaticAssetCache(const StaticAssetCache &) = delete;
+  StaticAssetCache &operator=(const StaticAssetCache &) = delete;
+
+  ~StaticAssetCache();
+
+  // Looks up an asset by the key ServeStatic derives from the base path and the request path.
+  std::shared_ptr<const Asset> find(std::string_view request_key);
+
+  // Reads a canonical file into the cache and links it to request_key; nullptr if it cannot be cached.
+  std::shared_ptr<const Asset> load(std::string request_key, const std::filesystem::path &canonical_path,
+                                    const std::string &mime, const std::string &content_encoding = {});
+
+  void invalidate(const std::filesystem::path &canonical_path);
+
+  // Drops every cached asset.
+  void clear();
+
+  [[nodiscard]] size_t memory_usage() const;
+
+  [[nodiscard]] size_t size() const;
+
+private:
+  struct Entry {
+    std::shared_ptr<const Asset> asset;
+    std::list<std::string>::iterator lru_position;
+    std::vector<std::string> request_keys;
+  };
+
+  struct KeyHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+  };
+
+  void watch_loop(const std::stop_token &token);
+
+  bool watch_directory(const std::filesystem::path &directory);
+
+  void erase_locked(const std::string &canonical_path);
+
+  // Detaches request_key from the entry it currently resolves to, unless that is canonical_path.
+  void unlink_request_key_locked(const std::string &request_key, const std::string &canonical_path);
+
+  void invalidate_directory(const std::filesystem::path &directory);
+
+  Parameters parameters_;
+  int inotify_fd_{-1};
+
+  mutable std::mutex mtx_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::unordered_map<std::string, std::string, KeyHash, std::equal_to<>> request_keys_;
+  std::list<std::string> lru_;
+  std::unordered_map<int, std::filesystem::path> watches_;
+  std::unordered_map<std::string, int> watched_directories_;
+  size_t memory_usage_{0};
+  // Bumped for every inotify event so a load that raced with a change does not publish stale bytes.
+  std::atomic<uint64_t> invalidation_epoch_{0};
+
+  std::jthread watch_thread_;
+};
+
+#endif // STATICASSETCACHE_HPP
@@ -0,0 +1,124 @@
+#ifndef TASK_HPP
+#define TASK_HPP
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <variant>
+
+template <typename T> class TaskResult {
+public:
+  template <typename U> void return_value(U &&value) { result_.template emplace<1>(std::forward<U>(value)); }
+
+  void unhandled_exception() noexcept { result_.template emplace<2>(std::current_exception()); }
+
+  T take() {
+    if (result_.index() == 2) {
+      std::rethrow_exception(std::get<2>(result_));
+    }
+    return std::move(std::get<1>(result_));
+  }
+
+private:
+  std::variant<std::monostate, T, std::exception_ptr> result_;
+};
+
+template <> class TaskResult<void> {
+public:
+  void return_void() noexcept {}
+
+  void unhandled_exception() noexcept { exception_ = std::current_exception(); }
+
+  void take() const {
+    if (exception_) {
+      std::rethrow_exception(exception_);
+    }
+  }
+
+private:
+  std::exception_ptr exception_;
+};
+
+// Lazy coroutine: nothing runs until the Task is co_awaited. The awaiter and the finishing Task race on one flag
+// instead of relying on symmetric transfer, which GCC only turns into a tail call with optimizations on: a Task that
+// completes synchronously lets its awaiter carry on without a nested resume, so loops over such Tasks do not grow
+// the stack. Exceptions thrown inside the coroutine are rethrown from co_await.
+template <typename T = void> class [[nodiscard]] Task {
+public:
+  struct promise_type : TaskResult<T> {
+    Task get_return_object() noexcept { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+
+    struct FinalAwaiter {
+      bool await_ready() const noexcept { return false; }
+
+      void await_suspend(std::coroutine_handle<promise_type> handle) const noexcept {
+        // Whoever comes second resumes the awaiter: here only if it already suspended.
+        promise_type &promise = handle.promise();
+        if (promise.finished.exchange(true, std::memory_order_acq_rel)) {
+          promise.continuation.resume();
+        }
+      }
+
+      void await_resume() const noexcept {}
+    };
+
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+
+    std::coroutine_handle<> continuation;
+    std::atomic<bool> finished{false};
+  };
+
+  Task(Task &&other) noexcept : handle_{std::exchange(other.handle_, {})} {}
+
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      if (handle_) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+
+  ~Task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept { return false; }
+
+  bool await_suspend(const std::coroutine_handle<> awaiting) noexcept {
+    handle_.promise().continuation = awaiting;
+    handle_.resume();
+    return !handle_.promise().finished.exchange(true, std::memory_order_acq_rel);
+  }
+
+  T await_resume() { return handle_.promise().take(); }
+
+private:
+  explicit Task(const std::coroutine_handle<promise_type> handle) : handle_{handle} {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+// Fire-and-forget coroutine for starting Tasks from plain code: it runs eagerly until its first suspension and
+// frees its own frame when it finishes. It has nowhere to report errors, so it must catch everything itself.
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() const noexcept { return {}; }
+
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+
+    std::suspend_never final_suspend() const noexcept { return {}; }
+
+    void return_void() const noexcept {}
+
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+#endif // TASK_HPP
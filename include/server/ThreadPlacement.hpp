@@ -0,0 +1,32 @@
+#ifndef THREADPLACEMENT_HPP
+#define THREADPLACEMENT_HPP
+
+#include <string>
+#include <vector>
+
+// CPU pinning and naming for the threads lws starts. Pinned threads allocate their per-thread state after pinning,
+// so Linux' first-touch policy places it on the thread's own NUMA node.
+class ThreadPlacement {
+public:
+  struct Affinity {
+    // Explicit CPU ids, handed out round-robin to the threads of a group.
+    std::vector<int> cpus;
+    // When `cpus` is empty: one logical CPU per physical core, skipping SMT siblings.
+    bool physical_cores{false};
+  };
+
+  // CPUs a thread group is spread over; empty means the threads are not pinned.
+  static std::vector<int> resolve(const Affinity &affinity);
+
+  // The first logical CPU of every physical core this process may run on.
+  static std::vector<int> physical_cores();
+
+  // CPU for the index-th thread of a group, -1 if unpinned.
+  static int cpu_for(const std::vector<int> &cpus, size_t index);
+
+  // Pins the calling thread to `cpu` unless it is negative and sets its name (cut to 15 characters, as
+  // shown by top and perf). Pinning failures are reported on stderr and leave the thread unpinned.
+  static void apply(int cpu, const std::string &name);
+};
+
+#endif // THREADPLACEMENT_HPP
@@ -1,33 +1,149 @@
 #ifndef THREADPOOL_HPP
 #define THREADPOOL_HPP
 
-#include <vector>
-#include <queue>
-#include <functional>
+#include <server/Job.hpp>
+#include <server/ThreadPlacement.hpp>
+#include <server/WorkStealingDeque.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <latch>
+#include <memory>
 #include <mutex>
-#include <condition_variable>
-#include <stop_token>
 #include <thread>
+#include <vector>
 
+// Work-stealing pool. Tasks submitted from a worker go to that worker's Chase-Lev deque; tasks from other
+// threads (the acceptor, event loops) go to a shared injection queue that workers drain in batches. Idle workers
+// steal from random victims and park on a futex-backed atomic instead of a shared condition variable.
 class Threadpool {
 public:
+  enum class AdmissionPolicy { REJECT, BLOCK, CODEL };
+
+  // Applies to submissions from outside the pool; tasks submitted by a running task are always admitted.
+  struct Admission {
+    // Maximum number of queued tasks, 0 for unbounded. REJECT sheds and BLOCK waits once it is reached.
+    size_t capacity{0};
+    AdmissionPolicy policy{AdmissionPolicy::REJECT};
+    // CODEL also sheds while the minimum queueing delay seen over `interval` stays above `target`.
+    std::chrono::milliseconds target{5};
+    std::chrono::milliseconds interval{100};
+  };
+
+  struct Parameters {
+    size_t num_threads{4};
+    Admission admission{};
+    ThreadPlacement::Affinity affinity{};
+    // Workers are named "<name>-<index>".
+    std::string name{"lws-worker"};
+  };
+
   explicit Threadpool(size_t num_threads);
+  explicit Threadpool(const Parameters &parameters);
   ~Threadpool();
 
-  void submit(std::function<void()> task);
+  // Returns false if the task was shed; it is then destroyed without running.
+  bool submit(Job task);
+
+  // Builds the Job straight from the callable; lambdas capturing up to Job::INLINE_SIZE bytes never allocate.
+  template <typename F>
+    requires(!std::same_as<std::remove_cvref_t<F>, Job> && std::invocable<std::decay_t<F> &>)
+  bool submit(F &&task) {
+    return submit(Job{std::forward<F>(task)});
+  }
 
   void request_stop();
 
   void wait_for_exit();
 
 private:
-  void worker_loop(const std::stop_token &stoken);
+  struct Task {
+    Job job;
+    // steady_clock time of submission in nanoseconds; only recorded under CODEL.
+    int64_t enqueued_at{0};
+  };
+
+  // Growable ring buffer; unlike std::deque it stops allocating once it has reached its working size.
+  class TaskRing {
+  public:
+    void push(Task task);
+    Task pop();
+    [[nodiscard]] bool empty() const { return size_ == 0; }
+    [[nodiscard]] size_t size() const { return size_; }
+
+  private:
+    std::vector<Task> tasks_;
+    size_t head_{0};
+    size_t size_{0};
+  };
+
+  // Tasks owned by a worker live in its slots; the deque only moves slot pointers between threads.
+  struct Slot {
+    Task task;
+    std::atomic<bool> busy{false};
+  };
+
+  struct Worker {
+    explicit Worker(size_t index);
+
+    WorkStealingDeque<Slot *> deque{WORKER_CAPACITY};
+    std::unique_ptr<Slot[]> slots{new Slot[WORKER_CAPACITY]};
+    size_t next_slot{0};
+    uint64_t rng_state;
+  };
+
+  static constexpr size_t WORKER_CAPACITY = 256;
+  static constexpr size_t INJECTION_BATCH = 32;
+
+  void worker_main(size_t index, int cpu, const std::string &name);
+
+  void worker_loop(Worker &self);
+
+  bool admit(bool local);
+
+  void on_dequeue(const Task &task);
+
+  Worker *local_worker() const;
+
+  static Slot *acquire_slot(Worker &worker);
+
+  static Task take(Slot &slot);
+
+  static bool push_local(Worker &worker, Task &task);
+
+  bool take_injected(Worker &worker, Task &task);
+
+  bool steal(Worker &thief, Task &task);
+
+  bool has_work() const;
+
+  void wake_one();
+
+  void park();
+
+  Admission admission_;
+  // Each worker allocates its own deque and slots after pinning, so they are local to its NUMA node.
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::latch workers_ready_;
+  std::vector<std::jthread> threads_;
+
+  std::mutex injection_mtx_;
+  TaskRing injection_;
+  std::atomic<size_t> injected_{0};
+
+  // Futex word parked workers wait on; bumped by every wake-up.
+  std::atomic<uint32_t> wake_epoch_{0};
+  std::atomic<uint32_t> sleepers_{0};
+  std::atomic<bool> shutdown_{false};
+
+  // Queued but not yet started tasks; submitters blocked by BLOCK wait on it.
+  std::atomic<size_t> pending_{0};
+  std::atomic<uint32_t> blocked_{0};
 
-  std::vector<std::jthread> workers_;
-  std::queue<std::function<void()>> tasks_;
-  std::mutex mtx_;
-  std::condition_variable_any cv_;
-  bool shutdown_{false};
+  std::atomic<int64_t> interval_start_{0};
+  std::atomic<int64_t> interval_min_delay_{INT64_MAX};
+  std::atomic<bool> overloaded_{false};
 };
 
-#endif // THREADPOOL_HPP
\ No newline at end of file
+#endif // THREADPOOL_HPP
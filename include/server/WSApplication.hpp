@@ -1,11 +1,17 @@
 #ifndef WSAPP_HPP
 #define WSAPP_HPP
+#include <array>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <server/SocketListener.hpp>
+#include <server/ThreadPlacement.hpp>
 #include <server/WebSocket.hpp>
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <variant>
 #include <vector>
 
@@ -13,10 +19,17 @@ class WSApplication {
 public:
   struct Parameters {
     SocketListener::Parameters socket_listener;
+    // The listener thread is pinned to the first CPU this resolves to.
+    ThreadPlacement::Affinity affinity{};
+    // Outbound queue limits and slow consumer policy of every connection.
+    WebSocket::Parameters websocket{};
   };
   using OpenHandler = std::function<void(WebSocket &)>;
   using MessageHandler = std::function<void(WebSocket &, std::string_view, WebSocket::OpCode)>;
   using CloseHandler = std::function<void(WebSocket &)>;
+  // The connection's fd in the low 32 bits and its slot's generation in the high 32, so a handle kept past the
+  // close of its connection never reaches a later connection that got the same fd.
+  using ConnectionId = uint64_t;
 
   explicit WSApplication(Parameters parameters);
 
@@ -24,7 +37,32 @@ public:
 
   void stop();
 
-  void add_connection(WebSocket &connection);
+  // Takes over the connection; safe to call from any thread. The open handler runs before the socket is
+  // registered, so it always precedes the connection's messages.
+  ConnectionId add_connection(WebSocket &connection);
+
+  // Empty when the connection is not (or no longer) registered.
+  std::optional<ConnectionId> connection_id(const WebSocket &connection) const;
+
+  // Sends to the connection behind `id`; empty when it has been closed since. Safe to call from any thread.
+  std::optional<WebSocket::SendStatus> send(ConnectionId id, std::span<const std::byte> payload,
+                                            WebSocket::OpCode opcode);
+  std::optional<WebSocket::SendStatus> send(ConnectionId id, const std::string &message, WebSocket::OpCode opcode);
+
+  const WebSocket::Parameters &websocket_parameters() const;
+
+  // A connection's subscriptions end when it closes; connections the application does not own are ignored.
+  void subscribe(WebSocket &connection, const std::string &topic);
+
+  void unsubscribe(WebSocket &connection, const std::string &topic);
+
+  // Frames the message once and queues the same buffer on every subscriber of the topic except `exclude`; with
+  // permessage-deflate, once per window size unless the connection keeps its compression context.
+  // Returns how many subscribers it was not dropped for. Safe to call from any thread.
+  size_t publish(const std::string &topic, std::span<const std::byte> payload,
+                 WebSocket::OpCode opcode = WebSocket::OpCode::TEXT, const WebSocket *exclude = nullptr);
+  size_t publish(const std::string &topic, const std::string &message,
+                 WebSocket::OpCode opcode = WebSocket::OpCode::TEXT, const WebSocket *exclude = nullptr);
 
   void on_open(OpenHandler handler);
 
@@ -33,15 +71,53 @@ public:
   void on_close(CloseHandler handler);
 
 private:
+  struct Slot {
+    std::unique_ptr<WebSocket> connection;
+    // Bumped whenever the slot is vacated.
+    uint32_t generation{0};
+  };
+
+  // Write interest of a connection being added, kept until its fd is registered with the listener.
+  struct Registration {
+    std::mutex mtx;
+    bool write_interest{false};
+    bool armed{false};
+  };
+
+  // Slots are indexed by fd / SHARD_COUNT within shard fd % SHARD_COUNT. Only the listener thread removes
+  // connections, so it may use a looked-up WebSocket after releasing the shard lock.
+  struct Shard {
+    mutable std::mutex mtx;
+    std::vector<Slot> slots;
+  };
+
+  Shard &shard_for(int fd);
+
+  std::optional<WebSocket::SendStatus> send(ConnectionId id, WebSocket::SharedMessage &message);
+
+  // The connection behind `id`, nullptr once it has been closed; the caller holds shard.mtx.
+  static WebSocket *find_connection_locked(const Shard &shard, ConnectionId id);
+
+  const Shard &shard_for(int fd) const;
+
+  WebSocket *find_connection(int fd) const;
+
   void process_message(int fd);
 
+  void close_connection(WebSocket &connection);
+
+  static constexpr size_t SHARD_COUNT = 16;
+
   Parameters parameters_;
-  std::unordered_map<uint64_t, WebSocket> connections;
-  uint64_t connection_counter = 0;
+  std::array<Shard, SHARD_COUNT> shards_;
   SocketListener socket_listener_;
 
   std::jthread listener_thread_;
 
+  std::mutex topics_mtx_;
+  std::unordered_map<std::string, std::unordered_map<WebSocket *, ConnectionId>> topics_;
+  std::unordered_map<WebSocket *, std::unordered_set<std::string>> subscriptions_;
+
   OpenHandler open_handler_ = nullptr;
   MessageHandler message_handler_ = nullptr;
   CloseHandler close_handler_ = nullptr;
@@ -1,37 +1,66 @@
 #ifndef WEBSOCKET_WEBSERVER_HPP
 #define WEBSOCKET_WEBSERVER_HPP
 
+#include "EventLoop.hpp"
+#include "HttpCompression.hpp"
+#include "HttpConnection.hpp"
 #include "HttpRequest.hpp"
 #include "HttpResponse.hpp"
+#include "server/Router.hpp"
+#include "server/Task.hpp"
 #include "server/Threadpool.hpp"
 #include "WSApplication.hpp"
 
 #include <condition_variable>
 #include <functional>
+#include <memory>
 #include <netinet/in.h>
 #include <stop_token>
 #include <thread>
 
 class WebServer {
 public:
-  using RouteHandler = std::function<HttpResponse(const HttpRequest&)>;
+  using RouteHandler = Router::Handler;
+  // Coroutine handlers suspend on event_loop() awaitables instead of blocking a worker while they wait.
+  using AsyncRouteHandler = Router::AsyncHandler;
 
   struct Parameters {
     std::string host{};
     int port{};
     size_t num_threads{4};
+    // Connections shed by the admission policy get a 503 with this Retry-After (seconds).
+    Threadpool::Admission admission{};
+    int overload_retry_after{1};
+    ThreadPlacement::Affinity worker_affinity{};
+    // Acceptor and keep-alive listener, or the reactor loops when `reactors` > 0.
+    ThreadPlacement::Affinity event_loop_affinity{};
     WSApplication::Parameters ws_app{};
+    HttpConnection::Parameters http_connection{};
+    size_t max_keep_alive_requests{100};
+    SocketListener::Parameters keep_alive_listener{};
+    // 0 keeps the single acceptor + thread pool model, N > 0 runs N SO_REUSEPORT event loops.
+    size_t reactors{0};
+    SocketListener::Parameters reactor_listener{.max_events = 64};
+    HttpCompression::Parameters compression{};
+    EventLoop::Parameters event_loop{};
   };
 
   explicit WebServer(Parameters parameters_);
 
   void get(const std::string &route, RouteHandler handler);
+  void get(const std::string &route, AsyncRouteHandler handler);
   void post(const std::string &route, RouteHandler handler);
+  void post(const std::string &route, AsyncRouteHandler handler);
   void put(const std::string &route, RouteHandler handler);
+  void put(const std::string &route, AsyncRouteHandler handler);
   void del(const std::string &route, RouteHandler handler);
+  void del(const std::string &route, AsyncRouteHandler handler);
   void patch(const std::string &route, RouteHandler handler);
+  void patch(const std::string &route, AsyncRouteHandler handler);
   void head(const std::string &route, RouteHandler handler);
+  void head(const std::string &route, AsyncRouteHandler handler);
   void options(const std::string &route, RouteHandler handler);
+  void options(const std::string &route, AsyncRouteHandler handler);
 
   WebServer& on_open(WSApplication::OpenHandler handler);
   WebServer& on_message(WSApplication::MessageHandler handler);
@@ -47,29 +76,102 @@ public:
 
   void on_http(int client_fd);
 
+  [[nodiscard]] int get_port() const;
+
+  // Readiness, timer and offload awaitables for AsyncRouteHandlers; woken handlers resume on the worker pool.
+  EventLoop &event_loop();
+
+  // Topic subscriptions and publish() for the upgraded connections.
+  WSApplication &websockets();
+
 private:
+  // PENDING: an async handler owns the connection and settles it once its coroutine finishes.
+  // WRITING: the socket is full; the connection waits for EPOLLOUT and serve_request finishes the response.
+  enum class ConnectionState { KEEP_ALIVE, CLOSE, UPGRADE, PENDING, WRITING };
+
+  struct Completion {
+    int fd;
+    ConnectionState state;
+    HttpRequest req;
+  };
+
+  struct Reactor {
+    int listen_fd{-1};
+    // Async handlers post their outcome here, so `connections` is only ever touched by the loop's own thread.
+    int wake_fd{-1};
+    std::unique_ptr<SocketListener> listener;
+    std::unordered_map<int, HttpConnection> connections;
+    std::mutex completed_mtx;
+    std::vector<Completion> completed;
+    std::jthread thread;
+  };
+
   void listen(int port);
 
+  int open_listen_socket(int port, bool reuse_port);
+
   void main_thread_acceptor(const std::stop_token& token);
 
+  void on_reactor_event(Reactor &reactor, int fd);
+
+  void on_reactor_wake(Reactor &reactor);
+
+  // `reactor` is the loop owning the connection, nullptr in the acceptor + thread pool model.
+  ConnectionState serve_request(HttpConnection &connection, HttpRequest &req, Reactor *reactor);
+
+  DetachedTask serve_async(const AsyncRouteHandler &handler, HttpConnection &connection, HttpRequest req,
+                           Reactor *reactor);
+
+  // Sends the response; CLOSE when the connection must be closed afterwards.
+  ConnectionState respond(HttpConnection &connection, const HttpRequest &req, HttpResponse &response);
+
+  ConnectionState write_response(HttpConnection &connection, HttpResponse &response, bool persistent);
+
+  void settle(Reactor *reactor, int client_fd, ConnectionState state, HttpRequest &req);
+
+  void upgrade_to_websocket(int client_fd, const HttpRequest &req);
+
   void handle(HttpRequest::HttpMethod method, const std::string &route, RouteHandler handler);
 
+  void handle(HttpRequest::HttpMethod method, const std::string &route, AsyncRouteHandler handler);
+
+  HttpConnection &get_connection(int client_fd);
+
+  // Re-arms the connection for `events`: EPOLLIN for the next request, EPOLLOUT to finish a response.
+  void keep_alive(int client_fd, uint32_t events = EPOLLIN);
+
+  void release_connection(int client_fd);
+
+  void close_connection(int client_fd);
+
+  void shed_connection(int client_fd);
+
   Parameters parameters;
-  int server_fd{};
+  int server_fd{-1};
   sockaddr_in address{};
   std::jthread server_thread;
   std::stop_source stop_source;
   Threadpool thread_pool_;
+  EventLoop event_loop_;
+  std::jthread event_loop_thread_;
+  const std::string overloaded_response_;
 
   bool is_running = false;
 
-  std::unordered_map<HttpRequest::HttpMethod, std::unordered_map<std::string, RouteHandler>> method_handlers;
+  Router router_;
 
   std::mutex mtx;
   std::condition_variable cv;
 
   WSApplication ws_app_;
 
+  std::unordered_map<int, HttpConnection> keep_alive_connections_;
+  std::mutex keep_alive_mtx_;
+  SocketListener keep_alive_listener_;
+  std::jthread keep_alive_thread_;
+
+  std::vector<std::unique_ptr<Reactor>> reactors_;
+
   bool shutdown_flag = false;
 };
 
@@ -1,10 +1,15 @@
 #ifndef WEBSOCKET_HPP
 #define WEBSOCKET_HPP
+#include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
-#include <queue>
+#include <mutex>
+#include <server/WebSocketDeflate.hpp>
+#include <span>
 #include <string>
+#include <sys/uio.h>
 #include <utility>
 #include <vector>
 
@@ -22,10 +27,39 @@ public:
     std::vector<uint8_t> payload;
   };
 
+  enum class SendStatus { SENT, QUEUED, DROPPED };
+  // What send() does once a peer that is not reading has more than high_water_mark bytes queued. DROP_OLDEST
+  // discards whole queued messages, except the first which may be partly on the wire already; DISCONNECT shuts
+  // the socket down so the listener closes the connection.
+  enum class SlowConsumerPolicy { DROP_OLDEST, DROP_NEWEST, DISCONNECT };
+
+  struct Parameters {
+    size_t high_water_mark{1024 * 1024};
+    SlowConsumerPolicy slow_consumer_policy{SlowConsumerPolicy::DISCONNECT};
+    WebSocketDeflate::Parameters deflate{};
+  };
+
+  // Complete frames of one message, immutable so the same buffer can sit in any number of outbound queues.
+  using EncodedMessage = std::shared_ptr<const std::string>;
+
+  // One message sent to many connections. Each frame variant (uncompressed, or deflated without context takeover
+  // for a given window size) is encoded by the first connection that needs it and shared by the rest.
+  struct SharedMessage {
+    std::span<const std::byte> payload;
+    OpCode opcode;
+    EncodedMessage raw;
+    EncodedMessage deflated[16];
+  };
+
   using MessageHandler = std::function<void(const std::string &, OpCode)>;
+  // Called with true when bytes are left queued and the socket should be watched for EPOLLOUT, and with false
+  // once flush() has drained the queue.
+  using WriteInterestHandler = std::function<void(bool)>;
 
   explicit WebSocket(int socket_fd);
 
+  WebSocket(int socket_fd, Parameters parameters);
+
   WebSocket(WebSocket&& other) noexcept;
 
   WebSocket& operator=(WebSocket &&) noexcept;
@@ -34,33 +68,119 @@ public:
 
   int get_fd() const;
 
-  void send(const std::string &message, OpCode opcode) const;
+  SendStatus send(const std::string &message, OpCode opcode);
+
+  // Never blocks. While nothing is queued the payload is written straight from the caller's memory: frame headers
+  // are built on the stack and gathered with the payload into one sendmsg (per FRAMES_PER_WRITE binary fragments).
+  // Whatever the socket does not take is copied into the outbound queue, which flush() drains; the slow consumer
+  // policy decides what happens past the high-water mark. Safe to call from any thread; throws when the peer is gone.
+  SendStatus send(std::span<const std::byte> payload, OpCode opcode);
+
+  // Frames a TEXT or BINARY message once, for sending the same bytes to many connections.
+  static EncodedMessage encode(std::span<const std::byte> payload, OpCode opcode);
+
+  // Like send(payload, opcode), but whatever is queued shares the encoded buffer instead of copying it. The frames
+  // go out as they are, never compressed.
+  SendStatus send(const EncodedMessage &message);
+
+  // Compresses when permessage-deflate was agreed; with context takeover that has to be done per connection.
+  SendStatus send(SharedMessage &message);
+
+  // Writes as much of the outbound queue as the socket takes. Returns false when the socket failed.
+  bool flush();
+
+  // Bytes queued but not yet written to the socket.
+  size_t buffered_amount() const;
 
-  void read_frame(std::string &message, OpCode &opcode) const;
+  void on_write_interest(WriteInterestHandler handler);
+
+  // Appends whatever the non-blocking socket has to the receive buffer without waiting for more. Returns false
+  // once the peer has closed the connection or the socket failed.
+  bool receive();
+
+  // Decodes the next complete message from the bytes received so far; false when it needs more bytes. Pings are
+  // answered on the way; protocol violations, including TEXT messages that are not UTF-8, throw. A CLOSE message
+  // carries the close frame's payload.
+  bool next_message(std::string &message, OpCode &opcode);
 
   std::string accept_handshake(const std::string &websocket_key);
 
+  // Agrees on permessage-deflate from the Sec-WebSocket-Extensions request header, if enabled in the parameters.
+  // Returns the response header value, empty when no extension was agreed.
+  std::string negotiate_extensions(std::string_view offers);
+
   void on_message(MessageHandler handler);
 
 private:
-  void get_websocket_frame(std::vector<uint8_t> &raw_message, uint8_t& op_code) const;
+  enum class DecodeStage { HEADER, PAYLOAD };
+
+  // Frame being decoded; its payload is unmasked into the message (or control payload) as bytes arrive.
+  struct FrameState {
+    DecodeStage stage{DecodeStage::HEADER};
+    bool fin{false};
+    uint8_t opcode{0};
+    bool masked{false};
+    uint8_t masking_key[4]{};
+    uint64_t remaining{0};
+    uint64_t received{0};
+  };
+
+  // Compresses the message when permessage-deflate applies, then splits it into frames of at most
+  // frame_size_limit(opcode) bytes: the first carries the opcode (and RSV1), the rest are continuations.
+  SendStatus send_frames(std::span<const std::byte> message, OpCode opcode);
+
+  static void append_frames(std::string &out, std::span<const std::byte> payload, OpCode opcode,
+                            size_t max_frame_size, bool compressed);
 
-  void send_frame(const std::vector<uint8_t> &data, OpCode opcode, bool is_final = true) const;
+  static size_t frame_size_limit(OpCode opcode);
 
-  std::vector<uint8_t> parse_frame(bool& out_final, uint8_t& out_opcode) const;
+  // Returns false on EAGAIN with iov and iov_count advanced past what was written.
+  bool write_some(iovec *&iov, int &iov_count) const;
+
+  SendStatus enqueue(EncodedMessage frames);
+
+  void set_write_interest(bool interested);
+
+  static size_t encode_header(uint8_t *header, OpCode opcode, bool is_final, uint64_t payload_length,
+                              bool compressed);
+
+  bool decode_header();
 
   OpCode to_opcode(uint8_t raw) const;
 
-  std::vector<uint8_t> payload_accumulator_;
-  std::queue<WebSocketFrame> frame_queue_;
-  std::mutex queue_mutex_;
+  std::vector<uint8_t> receive_buffer_;
+  size_t receive_begin_{0};
+  size_t receive_end_{0};
+  FrameState frame_;
+  // Opcode of the fragmented message in progress, 0 between messages.
+  uint8_t message_opcode_{0};
+  std::string message_buffer_;
+  std::string control_payload_;
 
   int socket_fd_;
   State state_;
   MessageHandler message_handler_;
+  Parameters parameters_;
+
+  mutable std::mutex send_mtx_;
+  // Encoded messages waiting for EPOLLOUT; the first outbound_offset_ bytes of the front one are already sent.
+  std::deque<EncodedMessage> outbound_;
+  size_t outbound_offset_{0};
+  size_t outbound_size_{0};
+  bool write_interest_{false};
+  WriteInterestHandler write_interest_handler_;
+
+  std::unique_ptr<WebSocketDeflate> deflate_;
+  // Whether the message being received has RSV1 set on its first frame.
+  bool message_compressed_{false};
 
-  static constexpr ssize_t MAX_TEXT_FRAME_SIZE = 4096;
   static constexpr ssize_t MAX_BINARY_FRAME_SIZE = 16384;
+  static constexpr size_t MAX_HEADER_SIZE = 10;
+  static constexpr size_t FRAMES_PER_WRITE = 32;
+  static constexpr size_t MAX_MESSAGE_SIZE = 16 * 1024 * 1024;
+  static constexpr size_t RECEIVE_CHUNK_SIZE = 16 * 1024;
+  // Bounds one receive() so a fast sender cannot starve the other connections of the listener thread.
+  static constexpr size_t MAX_RECEIVE_SIZE = 256 * 1024;
   static constexpr std::string_view WS_MAGIC = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
 };
 
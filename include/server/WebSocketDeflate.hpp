@@ -0,0 +1,75 @@
+#ifndef WEBSOCKETDEFLATE_HPP
+#define WEBSOCKETDEFLATE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// permessage-deflate (RFC 7692): negotiation and the per-connection pair of raw deflate streams.
+class WebSocketDeflate {
+public:
+  struct Parameters {
+    bool enabled{false};
+    // Smaller messages are sent uncompressed.
+    size_t min_size{128};
+    // zlib level, 1 (fastest) to 9 (smallest).
+    int level{6};
+    // Compress every message on its own. Costs ratio on repetitive traffic, but the compressed frame no longer
+    // depends on the connection, so WSApplication::publish can encode it once for all such subscribers.
+    bool server_no_context_takeover{false};
+    // Upper bound for both LZ77 windows, 9 to 15.
+    int max_window_bits{15};
+    int mem_level{8};
+    // Estimated zlib memory of both streams of one connection. Window bits and memLevel shrink until it fits;
+    // the extension is declined when the client's window cannot be limited enough.
+    size_t max_memory{128 * 1024};
+  };
+
+  struct Agreement {
+    bool server_no_context_takeover{false};
+    bool client_no_context_takeover{false};
+    int server_max_window_bits{15};
+    int client_max_window_bits{15};
+    int mem_level{8};
+    // Offered parameters that the response has to answer.
+    bool server_max_window_bits_offered{false};
+    bool client_max_window_bits_offered{false};
+  };
+
+  // Picks the first acceptable offer of a Sec-WebSocket-Extensions request header. Empty when none is, when the
+  // extension is disabled or when lws was built without zlib.
+  static std::optional<Agreement> negotiate(std::string_view offers, const Parameters &parameters);
+
+  // The Sec-WebSocket-Extensions response header value for an agreement.
+  static std::string response_header(const Agreement &agreement);
+
+  static size_t estimated_memory(int server_window_bits, int client_window_bits, int mem_level);
+
+  // Compresses one message with a fresh stream, as a connection without context takeover would.
+  static std::string compress_once(std::string_view message, int window_bits, int level, int mem_level);
+
+  WebSocketDeflate(const Agreement &agreement, const Parameters &parameters);
+
+  ~WebSocketDeflate();
+
+  // Appends the compressed message, without the trailing empty deflate block, to `out`.
+  void compress(std::string_view message, std::string &out);
+
+  // Throws when the data is corrupt or inflates past max_size bytes.
+  std::string decompress(std::string_view compressed, size_t max_size);
+
+  [[nodiscard]] const Agreement &agreement() const;
+
+  [[nodiscard]] const Parameters &parameters() const;
+
+private:
+  struct Streams;
+
+  Agreement agreement_;
+  Parameters parameters_;
+  std::unique_ptr<Streams> streams_;
+};
+
+#endif // WEBSOCKETDEFLATE_HPP
@@ -0,0 +1,29 @@
+#ifndef WEBSOCKETPAYLOAD_HPP
+#define WEBSOCKETPAYLOAD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Payload kernels for WebSocket frames. The widest instruction set the CPU supports is detected once; the scalar
+// versions are the reference implementation and the fallback on other architectures.
+class WebSocketPayload {
+public:
+  enum class Isa { SCALAR, SSE2, AVX2, AVX512, NEON };
+
+  static Isa detected_isa();
+
+  [[nodiscard]] static bool is_supported(Isa isa);
+
+  // XORs `data` with the masking key, where data[0] is byte `offset` of the frame's payload.
+  static void unmask(char *data, size_t size, const uint8_t (&masking_key)[4], uint64_t offset);
+  static void unmask(Isa isa, char *data, size_t size, const uint8_t (&masking_key)[4], uint64_t offset);
+
+  // RFC 3629 validation: rejects overlongs, surrogates, code points above U+10FFFF and truncated sequences.
+  // The vector version (Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte") needs AVX2;
+  // narrower ISAs use the scalar version, which skips ASCII eight bytes at a time.
+  [[nodiscard]] static bool is_valid_utf8(std::string_view text);
+  [[nodiscard]] static bool is_valid_utf8(Isa isa, std::string_view text);
+};
+
+#endif // WEBSOCKETPAYLOAD_HPP
@@ -0,0 +1,87 @@
+#ifndef WORKSTEALINGDEQUE_HPP
+#define WORKSTEALINGDEQUE_HPP
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+
+// Chase-Lev deque (Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models"). The owning thread
+// pushes and pops at the bottom, any other thread steals from the top. The capacity is fixed: push reports
+// failure instead of growing, so callers keep the number of outstanding items bounded.
+template <typename T> class WorkStealingDeque {
+  static_assert(std::is_trivially_copyable_v<T>, "WorkStealingDeque stores items in atomics");
+
+public:
+  explicit WorkStealingDeque(const size_t capacity) : mask_{capacity - 1}, buffer_{new std::atomic<T>[capacity]} {
+    if (capacity == 0 || !std::has_single_bit(capacity)) {
+      throw std::invalid_argument("WorkStealingDeque capacity must be a power of two");
+    }
+  }
+
+  // Owner only.
+  bool push(const T item) {
+    const int64_t b = bottom_.load(std::memory_order_relaxed);
+    const int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t > static_cast<int64_t>(mask_)) {
+      return false;
+    }
+    buffer_[b & mask_].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Owner only.
+  std::optional<T> pop() {
+    const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return std::nullopt;
+    }
+    T item = buffer_[b & mask_].load(std::memory_order_relaxed);
+    if (t == b) {
+      // Last item: race the thieves for it.
+      const bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      if (!won) {
+        return std::nullopt;
+      }
+    }
+    return item;
+  }
+
+  // Any thread. Also fails spuriously when another thief wins the race for the same item.
+  std::optional<T> steal() {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return std::nullopt;
+    }
+    T item = buffer_[t & mask_].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return std::nullopt;
+    }
+    return item;
+  }
+
+  [[nodiscard]] bool empty() const {
+    const int64_t t = top_.load(std::memory_order_acquire);
+    return bottom_.load(std::memory_order_acquire) <= t;
+  }
+
+private:
+  alignas(64) std::atomic<int64_t> top_{0};
+  alignas(64) std::atomic<int64_t> bottom_{0};
+  const size_t mask_;
+  std::unique_ptr<std::atomic<T>[]> buffer_;
+};
+
+#endif // WORKSTEALINGDEQUE_HPP
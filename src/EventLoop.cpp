@@ -0,0 +1,117 @@
+#include <server/EventLoop.hpp>
+
+#include <sys/timerfd.h>
+
+EventLoop::EventLoop(Parameters parameters, Threadpool *pool)
+    : pool_{pool}, timer_fd_{timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)},
+      listener_{parameters.listener, [this](const int fd) { on_event(fd); }} {
+  if (timer_fd_ < 0) {
+    throw std::runtime_error(std::string("timerfd_create failed: ") + strerror(errno));
+  }
+  listener_.add_socket(timer_fd_, EPOLLIN);
+}
+
+EventLoop::~EventLoop() { close(timer_fd_); }
+
+void EventLoop::run() { listener_.run(); }
+
+void EventLoop::stop() { listener_.stop(); }
+
+EventLoop::ReadinessAwaiter EventLoop::readable(const int fd) { return {*this, fd, EPOLLIN | EPOLLRDHUP}; }
+
+EventLoop::ReadinessAwaiter EventLoop::writable(const int fd) { return {*this, fd, EPOLLOUT}; }
+
+EventLoop::TimerAwaiter EventLoop::sleep_for(const std::chrono::steady_clock::duration duration) {
+  return {*this, std::chrono::steady_clock::now() + duration};
+}
+
+EventLoop::TimerAwaiter EventLoop::sleep_until(const std::chrono::steady_clock::time_point deadline) {
+  return {*this, deadline};
+}
+
+EventLoop::OffloadAwaiter EventLoop::offload() { return OffloadAwaiter{pool_}; }
+
+void EventLoop::watch(const int fd, const uint32_t events, const std::coroutine_handle<> handle) {
+  {
+    std::scoped_lock lock(mtx_);
+    if (!waiters_.try_emplace(fd, handle).second) {
+      throw std::invalid_argument("EventLoop: fd " + std::to_string(fd) + " already has a waiting coroutine");
+    }
+  }
+  // The coroutine may be resumed on another thread as soon as the fd is registered; nothing touches it after.
+  try {
+    listener_.add_socket(fd, events | EPOLLONESHOT);
+  } catch (...) {
+    std::scoped_lock lock(mtx_);
+    waiters_.erase(fd);
+    throw;
+  }
+}
+
+void EventLoop::schedule(const std::chrono::steady_clock::time_point deadline, const std::coroutine_handle<> handle) {
+  std::scoped_lock lock(mtx_);
+  const uint64_t sequence = next_sequence_++;
+  timers_.push({deadline, sequence, handle});
+  if (timers_.top().sequence == sequence) {
+    arm_timer(deadline);
+  }
+}
+
+void EventLoop::on_event(const int fd) {
+  if (fd == timer_fd_) {
+    on_timer();
+    return;
+  }
+  std::coroutine_handle<> handle;
+  {
+    std::scoped_lock lock(mtx_);
+    const auto it = waiters_.find(fd);
+    if (it == waiters_.end()) {
+      return;
+    }
+    handle = it->second;
+    waiters_.erase(it);
+  }
+  listener_.remove_socket(fd);
+  resume(handle);
+}
+
+void EventLoop::on_timer() {
+  uint64_t expirations;
+  while (read(timer_fd_, &expirations, sizeof(expirations)) > 0) {
+  }
+
+  std::vector<std::coroutine_handle<>> expired;
+  {
+    std::scoped_lock lock(mtx_);
+    const auto now = std::chrono::steady_clock::now();
+    while (!timers_.empty() && timers_.top().deadline <= now) {
+      expired.push_back(timers_.top().handle);
+      timers_.pop();
+    }
+    if (!timers_.empty()) {
+      arm_timer(timers_.top().deadline);
+    }
+  }
+  for (const std::coroutine_handle<> handle: expired) {
+    resume(handle);
+  }
+}
+
+void EventLoop::arm_timer(const std::chrono::steady_clock::time_point deadline) const {
+  // steady_clock is CLOCK_MONOTONIC; an all-zero it_value would disarm the timer instead of firing it.
+  const auto ns = std::max<int64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count(), 1);
+  itimerspec spec{};
+  spec.it_value.tv_sec = ns / 1'000'000'000;
+  spec.it_value.tv_nsec = ns % 1'000'000'000;
+  if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+    throw std::runtime_error(std::string("timerfd_settime failed: ") + strerror(errno));
+  }
+}
+
+void EventLoop::resume(const std::coroutine_handle<> handle) const {
+  if (pool_ == nullptr || !pool_->submit([handle] { handle.resume(); })) {
+    handle.resume();
+  }
+}
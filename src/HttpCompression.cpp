@@ -0,0 +1,131 @@
+#include <server/HttpCompression.hpp>
+
+#include <charconv>
+#include <stdexcept>
+
+#ifdef LWS_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+static std::string_view trim(std::string_view str) {
+  while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+    str.remove_prefix(1);
+  }
+  while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+    str.remove_suffix(1);
+  }
+  return str;
+}
+
+// Parses "q=0.5"-style weights; anything unparsable counts as the default weight of 1.
+static double parse_weight(std::string_view parameters) {
+  while (!parameters.empty()) {
+    const size_t semicolon = parameters.find(';');
+    const std::string_view parameter = trim(parameters.substr(0, semicolon));
+    parameters = semicolon == std::string_view::npos ? std::string_view{} : parameters.substr(semicolon + 1);
+    if (parameter.size() > 2 && (parameter[0] == 'q' || parameter[0] == 'Q') && parameter[1] == '=') {
+      double weight = 1.0;
+      std::from_chars(parameter.data() + 2, parameter.data() + parameter.size(), weight);
+      return weight;
+    }
+  }
+  return 1.0;
+}
+
+bool HttpCompression::accepts(std::string_view accept_encoding, const std::string_view coding) {
+  double wildcard = 0.0;
+  while (!accept_encoding.empty()) {
+    const size_t comma = accept_encoding.find(',');
+    const std::string_view item = accept_encoding.substr(0, comma);
+    accept_encoding = comma == std::string_view::npos ? std::string_view{} : accept_encoding.substr(comma + 1);
+
+    const size_t semicolon = item.find(';');
+    const std::string_view name = trim(item.substr(0, semicolon));
+    const double weight = semicolon == std::string_view::npos ? 1.0 : parse_weight(item.substr(semicolon + 1));
+    if (ascii_iequals(name, coding)) {
+      return weight > 0.0;
+    }
+    if (name == "*") {
+      wildcard = weight;
+    }
+  }
+  return wildcard > 0.0;
+}
+
+bool HttpCompression::is_compressible(std::string_view content_type) {
+  content_type = trim(content_type.substr(0, content_type.find(';')));
+  return content_type.starts_with("text/") || content_type.ends_with("/json") || content_type.ends_with("+json") ||
+         content_type.ends_with("/javascript") || content_type.ends_with("/xml") || content_type.ends_with("+xml");
+}
+
+bool HttpCompression::compress(HttpResponse &response, const HttpRequest &request, const Parameters &parameters) {
+  const int status = response.status_code;
+  if (!is_available() || status < 200 || status >= 300 || status == 204 || status == 206 || response.file_body ||
+      !response.body_parts.empty() || response.preserialized_headers ||
+      response.headers.contains(HttpHeader::CONTENT_ENCODING) || response.body_data().size() < parameters.min_size) {
+    return false;
+  }
+  const auto content_type = response.headers.find(HttpHeader::CONTENT_TYPE);
+  if (content_type == response.headers.end() || !is_compressible(content_type->second)) {
+    return false;
+  }
+
+  // The representation now depends on Accept-Encoding, whether or not this client gets the gzipped one.
+  if (const auto vary = response.headers.find(HttpHeader::VARY); vary == response.headers.end()) {
+    response.headers.set(HttpHeader::VARY, "Accept-Encoding");
+  } else if (vary->second.find("Accept-Encoding") == std::string::npos) {
+    response.headers.set(HttpHeader::VARY, vary->second + ", Accept-Encoding");
+  }
+
+  const auto accept_encoding = request.headers.find(HttpHeader::ACCEPT_ENCODING);
+  if (accept_encoding == request.headers.end() || !accepts(accept_encoding->second, "gzip")) {
+    return false;
+  }
+
+  std::string compressed = gzip(response.body_data(), parameters.level);
+  if (compressed.size() >= response.body_data().size()) {
+    return false;
+  }
+  response.body = std::move(compressed);
+  response.shared_body.reset();
+  response.headers.set(HttpHeader::CONTENT_ENCODING, "gzip");
+  if (const auto etag = response.headers.find(HttpHeader::ETAG);
+      etag != response.headers.end() && !etag->second.starts_with("W/")) {
+    response.headers.set(HttpHeader::ETAG, "W/" + etag->second);
+  }
+  return true;
+}
+
+bool HttpCompression::is_available() {
+#ifdef LWS_HAS_ZLIB
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::string HttpCompression::gzip(const std::string_view data, const int level) {
+#ifdef LWS_HAS_ZLIB
+  z_stream stream{};
+  // windowBits 15 + 16 selects the gzip wrapper instead of raw zlib.
+  if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("deflateInit2 failed");
+  }
+  std::string out(deflateBound(&stream, data.size()), '\0');
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+  stream.avail_in = data.size();
+  stream.next_out = reinterpret_cast<Bytef *>(out.data());
+  stream.avail_out = out.size();
+  const int result = deflate(&stream, Z_FINISH);
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END) {
+    throw std::runtime_error("deflate failed");
+  }
+  out.resize(stream.total_out);
+  return out;
+#else
+  (void)data;
+  (void)level;
+  throw std::runtime_error("lws was built without zlib");
+#endif
+}
@@ -0,0 +1,306 @@
+#include <server/HttpConnection.hpp>
+#include <server/HttpHeaders.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static constexpr std::string_view CRLF = "\r\n";
+static constexpr std::string_view HEADER_TERMINATOR = "\r\n\r\n";
+
+static std::string_view trim(std::string_view str) {
+  while (!str.empty() && std::isspace(static_cast<unsigned char>(str.front()))) {
+    str.remove_prefix(1);
+  }
+  while (!str.empty() && std::isspace(static_cast<unsigned char>(str.back()))) {
+    str.remove_suffix(1);
+  }
+  return str;
+}
+
+static bool icontains(std::string_view haystack, std::string_view needle) {
+  for (size_t i = 0; i + needle.size() <= haystack.size(); ++i) {
+    if (ascii_iequals(haystack.substr(i, needle.size()), needle)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+HttpConnection::HttpConnection(const int fd) : fd_{fd} {}
+
+int HttpConnection::get_fd() const { return fd_; }
+
+HttpConnection::ReadStatus HttpConnection::read_request(const Parameters &parameters) {
+  while (true) {
+    const ReadStatus status = frame_request(parameters);
+    if (status != ReadStatus::INCOMPLETE) {
+      return status;
+    }
+
+    size_t read_size = READ_CHUNK_SIZE;
+    if (header_end_ != std::string::npos && !chunked_) {
+      read_size = std::clamp(request_end_ - buffer_.size(), READ_CHUNK_SIZE, MAX_READ_SIZE);
+    }
+
+    const size_t old_size = buffer_.size();
+    buffer_.resize(old_size + read_size);
+    const ssize_t n = read(fd_, buffer_.data() + old_size, read_size);
+    buffer_.resize(old_size + std::max<ssize_t>(n, 0));
+
+    if (n == 0) {
+      return ReadStatus::CLOSED;
+    }
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK ? ReadStatus::INCOMPLETE : ReadStatus::CLOSED;
+    }
+  }
+}
+
+std::string HttpConnection::take_request() {
+  std::string request = std::move(buffer_);
+  buffer_ = request.substr(request_end_);
+  request.resize(body_end_);
+  reset_framing();
+  return request;
+}
+
+bool HttpConnection::has_buffered_data() const { return !buffer_.empty(); }
+
+HttpConnection::SendStatus HttpConnection::send_response(HttpResponse response) {
+  pending_response_ = std::move(response);
+  head_buffer_.clear();
+  pending_response_.serialize_head(head_buffer_);
+
+  segments_.clear();
+  next_segment_ = 0;
+  segments_.push_back({.data = head_buffer_});
+  const auto add_file = [this](const HttpResponse::FileBody &file_body) {
+    if (file_body.length > 0) {
+      segments_.push_back({.file_fd = file_body.file->get_fd(), .offset = file_body.offset, .length = file_body.length});
+    }
+  };
+  if (pending_response_.file_body) {
+    add_file(*pending_response_.file_body);
+  } else if (!pending_response_.body_parts.empty()) {
+    for (const auto &part: pending_response_.body_parts) {
+      if (!part.data.empty()) {
+        segments_.push_back({.data = part.data});
+      }
+      if (part.file) {
+        add_file(*part.file);
+      }
+    }
+  } else if (const std::string_view body = pending_response_.body_data(); !body.empty()) {
+    segments_.push_back({.data = body});
+  }
+  return flush();
+}
+
+HttpConnection::SendStatus HttpConnection::flush() {
+  while (next_segment_ < segments_.size()) {
+    const SendStatus status =
+        segments_[next_segment_].file_fd >= 0 ? send_file(segments_[next_segment_]) : send_data();
+    if (status != SendStatus::COMPLETE) {
+      return status;
+    }
+  }
+  // Drops the response, and with it any file descriptors it holds.
+  segments_.clear();
+  next_segment_ = 0;
+  pending_response_ = {};
+  return SendStatus::COMPLETE;
+}
+
+bool HttpConnection::has_pending_output() const { return next_segment_ < segments_.size(); }
+
+HttpConnection::SendStatus HttpConnection::send_data() {
+  // Gathers the byte segments up to the next file range; MSG_MORE holds the last packet back when more follows.
+  while (next_segment_ < segments_.size() && segments_[next_segment_].file_fd < 0) {
+    iovec iov[MAX_IOV];
+    int iov_count = 0;
+    size_t end = next_segment_;
+    for (; end < segments_.size() && segments_[end].file_fd < 0 && iov_count < static_cast<int>(MAX_IOV); ++end) {
+      iov[iov_count++] = {const_cast<char *>(segments_[end].data.data()), segments_[end].data.size()};
+    }
+    msghdr message{};
+    message.msg_iov = iov;
+    message.msg_iovlen = iov_count;
+    ssize_t n = sendmsg(fd_, &message, MSG_NOSIGNAL | MSG_DONTWAIT | (end < segments_.size() ? MSG_MORE : 0));
+    if (n < 0 && errno == ENOTSOCK) {
+      n = writev(fd_, iov, iov_count);
+    }
+
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK ? SendStatus::PENDING : SendStatus::FAILED;
+    }
+
+    auto written = static_cast<size_t>(n);
+    while (next_segment_ < end && written >= segments_[next_segment_].data.size()) {
+      written -= segments_[next_segment_].data.size();
+      ++next_segment_;
+    }
+    if (next_segment_ < end) {
+      segments_[next_segment_].data.remove_prefix(written);
+    }
+  }
+  return SendStatus::COMPLETE;
+}
+
+HttpConnection::SendStatus HttpConnection::send_file(Segment &segment) {
+  while (segment.length > 0) {
+    const ssize_t n = sendfile(fd_, segment.file_fd, &segment.offset, segment.length);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK ? SendStatus::PENDING : SendStatus::FAILED;
+    }
+    if (n == 0) {
+      // The file was truncated underneath us; the promised Content-Length can no longer be honoured.
+      return SendStatus::FAILED;
+    }
+    segment.length -= n;
+  }
+  ++next_segment_;
+  return SendStatus::COMPLETE;
+}
+
+HttpConnection::ReadStatus HttpConnection::frame_request(const Parameters &parameters) {
+  if (complete_) {
+    return ReadStatus::COMPLETE;
+  }
+
+  if (header_end_ == std::string::npos) {
+    const size_t pos = buffer_.find(HEADER_TERMINATOR, scanned_);
+    if (pos == std::string::npos) {
+      if (buffer_.size() > parameters.max_header_size) {
+        return ReadStatus::HEADERS_TOO_LARGE;
+      }
+      scanned_ = buffer_.size() < HEADER_TERMINATOR.size() ? 0 : buffer_.size() - HEADER_TERMINATOR.size() + 1;
+      return ReadStatus::INCOMPLETE;
+    }
+    if (pos + HEADER_TERMINATOR.size() > parameters.max_header_size) {
+      return ReadStatus::HEADERS_TOO_LARGE;
+    }
+    header_end_ = pos + HEADER_TERMINATOR.size();
+
+    size_t content_length = 0;
+    const std::string_view headers = std::string_view{buffer_}.substr(0, pos);
+    size_t line_start = headers.find(CRLF);
+    while (line_start != std::string_view::npos) {
+      line_start += CRLF.size();
+      const size_t line_end = headers.find(CRLF, line_start);
+      const std::string_view line = headers.substr(line_start, line_end - line_start);
+      line_start = line_end;
+
+      const size_t colon = line.find(':');
+      if (colon == std::string_view::npos) {
+        continue;
+      }
+      const std::string_view key = trim(line.substr(0, colon));
+      const std::string_view value = trim(line.substr(colon + 1));
+      const HttpHeader header = http_header_id(key);
+      if (header == HttpHeader::TRANSFER_ENCODING) {
+        chunked_ = icontains(value, "chunked");
+      } else if (header == HttpHeader::CONTENT_LENGTH) {
+        const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), content_length);
+        if (ec != std::errc{} || ptr != value.data() + value.size()) {
+          return ReadStatus::BAD_REQUEST;
+        }
+      }
+    }
+
+    if (chunked_) {
+      body_end_ = header_end_;
+      chunk_pos_ = header_end_;
+    } else {
+      if (content_length > parameters.max_body_size) {
+        return ReadStatus::BODY_TOO_LARGE;
+      }
+      body_end_ = header_end_ + content_length;
+      request_end_ = body_end_;
+    }
+  }
+
+  if (chunked_) {
+    return frame_chunked_body(parameters);
+  }
+  if (buffer_.size() < request_end_) {
+    return ReadStatus::INCOMPLETE;
+  }
+  complete_ = true;
+  return ReadStatus::COMPLETE;
+}
+
+HttpConnection::ReadStatus HttpConnection::frame_chunked_body(const Parameters &parameters) {
+  // Chunk payloads are compacted in place right after the headers, so body_end_ never passes chunk_pos_.
+  while (true) {
+    const size_t line_end = buffer_.find(CRLF, chunk_pos_);
+    if (line_end == std::string::npos) {
+      return buffer_.size() - chunk_pos_ > MAX_CHUNK_LINE_SIZE ? ReadStatus::BAD_REQUEST : ReadStatus::INCOMPLETE;
+    }
+
+    std::string_view size_line = std::string_view{buffer_}.substr(chunk_pos_, line_end - chunk_pos_);
+    size_line = trim(size_line.substr(0, size_line.find(';')));
+    size_t chunk_size = 0;
+    const auto [ptr, ec] = std::from_chars(size_line.data(), size_line.data() + size_line.size(), chunk_size, 16);
+    if (size_line.empty() || ec != std::errc{} || ptr != size_line.data() + size_line.size()) {
+      return ReadStatus::BAD_REQUEST;
+    }
+
+    const size_t data_start = line_end + CRLF.size();
+    if (chunk_size == 0) {
+      if (buffer_.compare(data_start, CRLF.size(), CRLF) == 0) {
+        request_end_ = data_start + CRLF.size();
+      } else {
+        const size_t trailers_end = buffer_.find(HEADER_TERMINATOR, line_end);
+        if (trailers_end == std::string::npos) {
+          return buffer_.size() - data_start > parameters.max_header_size ? ReadStatus::HEADERS_TOO_LARGE
+                                                                          : ReadStatus::INCOMPLETE;
+        }
+        request_end_ = trailers_end + HEADER_TERMINATOR.size();
+      }
+      complete_ = true;
+      return ReadStatus::COMPLETE;
+    }
+
+    // Written so that neither check can wrap around for a huge chunk size.
+    if (chunk_size > parameters.max_body_size - (body_end_ - header_end_)) {
+      return ReadStatus::BODY_TOO_LARGE;
+    }
+    if (buffer_.size() - data_start < CRLF.size() || buffer_.size() - data_start - CRLF.size() < chunk_size) {
+      return ReadStatus::INCOMPLETE;
+    }
+    if (buffer_.compare(data_start + chunk_size, CRLF.size(), CRLF) != 0) {
+      return ReadStatus::BAD_REQUEST;
+    }
+
+    std::memmove(buffer_.data() + body_end_, buffer_.data() + data_start, chunk_size);
+    body_end_ += chunk_size;
+    chunk_pos_ = data_start + chunk_size + CRLF.size();
+  }
+}
+
+void HttpConnection::reset_framing() {
+  scanned_ = 0;
+  header_end_ = std::string::npos;
+  body_end_ = 0;
+  chunk_pos_ = 0;
+  request_end_ = 0;
+  chunked_ = false;
+  complete_ = false;
+}
@@ -0,0 +1,88 @@
+#include <server/HttpHeaders.hpp>
+
+static constexpr std::array<std::string_view, static_cast<size_t>(HttpHeader::COUNT)> HEADER_NAMES = {
+    "Accept",
+    "Accept-Encoding",
+    "Accept-Ranges",
+    "Cache-Control",
+    "Connection",
+    "Content-Encoding",
+    "Content-Length",
+    "Content-Range",
+    "Content-Type",
+    "Cookie",
+    "Date",
+    "ETag",
+    "Host",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "Keep-Alive",
+    "Last-Modified",
+    "Location",
+    "Range",
+    "Retry-After",
+    "Sec-WebSocket-Accept",
+    "Sec-WebSocket-Extensions",
+    "Sec-WebSocket-Key",
+    "Sec-WebSocket-Version",
+    "Transfer-Encoding",
+    "Upgrade",
+    "User-Agent",
+    "Vary",
+};
+
+static constexpr char to_lower(const char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c | 0x20) : c; }
+
+// Length, first and last letter tell the well-known names apart, so an ID lookup is one slot and one comparison.
+static constexpr size_t header_slot(const std::string_view name) {
+  return (name.size() * 7 + static_cast<unsigned char>(to_lower(name.front())) +
+          (static_cast<size_t>(static_cast<unsigned char>(to_lower(name.back()))) << 3)) &
+         127;
+}
+
+static constexpr std::array<HttpHeader, 128> HEADER_SLOTS = [] {
+  std::array<HttpHeader, 128> slots{};
+  slots.fill(HttpHeader::UNKNOWN);
+  for (size_t i = 0; i < HEADER_NAMES.size(); ++i) {
+    slots[header_slot(HEADER_NAMES[i])] = static_cast<HttpHeader>(i);
+  }
+  return slots;
+}();
+
+static_assert(
+    [] {
+      for (size_t i = 0; i < HEADER_NAMES.size(); ++i) {
+        if (HEADER_SLOTS[header_slot(HEADER_NAMES[i])] != static_cast<HttpHeader>(i)) {
+          return false;
+        }
+      }
+      return true;
+    }(),
+    "Well-known header names must hash to distinct slots");
+
+std::string_view http_header_name(const HttpHeader header) {
+  return header == HttpHeader::UNKNOWN ? std::string_view{} : HEADER_NAMES[static_cast<size_t>(header)];
+}
+
+HttpHeader http_header_id(const std::string_view name) {
+  if (name.empty()) {
+    return HttpHeader::UNKNOWN;
+  }
+  const HttpHeader header = HEADER_SLOTS[header_slot(name)];
+  return header != HttpHeader::UNKNOWN && ascii_iequals(HEADER_NAMES[static_cast<size_t>(header)], name)
+             ? header
+             : HttpHeader::UNKNOWN;
+}
+
+bool ascii_iequals(const std::string_view lhs, const std::string_view rhs) {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    if (to_lower(lhs[i]) != to_lower(rhs[i])) {
+      return false;
+    }
+  }
+  return true;
+}
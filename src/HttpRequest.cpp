@@ -1,41 +1,71 @@
 #include "server/HttpRequest.hpp"
-#include <sstream>
+#include "server/HttpTokenizer.hpp"
 #include <algorithm>
 #include <cctype>
 #include <iostream>
 
-static std::string trim(const std::string &str) {
-    auto start = str.begin();
-    while (start != str.end() && std::isspace(*start)) ++start;
-
-    auto end = str.end();
-    do {
-        --end;
-    } while (std::distance(start, end) > 0 && std::isspace(*end));
+static std::string_view trim(std::string_view str) {
+    while (!str.empty() && std::isspace(static_cast<unsigned char>(str.front()))) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && std::isspace(static_cast<unsigned char>(str.back()))) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
 
-    return std::string(start, end + 1);
+static bool icontains(std::string_view haystack, std::string_view needle) {
+    const auto it = std::ranges::search(haystack, needle, [](const char a, const char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+    });
+    return !it.empty();
 }
 
-static std::map<std::string, std::string> parse_query_params(const std::string &query_str) {
-    std::map<std::string, std::string> params;
-    std::istringstream query_stream(query_str);
-    std::string pair;
-
-    while (std::getline(query_stream, pair, '&')) {
-        size_t equal_pos = pair.find('=');
-        if (equal_pos != std::string::npos) {
-            std::string key = pair.substr(0, equal_pos);
-            std::string value = pair.substr(equal_pos + 1);
-            params[key] = value;
+static std::map<std::string_view, std::string_view> parse_query_params(std::string_view query_str) {
+    std::map<std::string_view, std::string_view> params;
+
+    while (!query_str.empty()) {
+        const size_t amp = query_str.find('&');
+        const std::string_view pair = query_str.substr(0, amp);
+        query_str = amp == std::string_view::npos ? std::string_view{} : query_str.substr(amp + 1);
+        if (pair.empty()) {
+            continue;
+        }
+
+        const size_t equal_pos = pair.find('=');
+        if (equal_pos != std::string_view::npos) {
+            params.insert_or_assign(pair.substr(0, equal_pos), pair.substr(equal_pos + 1));
         } else {
-            params[pair] = "";
+            params.insert_or_assign(pair, std::string_view{});
         }
     }
 
     return params;
 }
 
-HttpRequest::HttpMethod HttpRequest::parse_http_method(const std::string &method_str) {
+// Splits off the next line, accepting both CRLF and bare LF terminators.
+static bool next_line(std::string_view &rest, std::string_view &line) {
+    if (rest.empty()) {
+        return false;
+    }
+    const size_t lf = HttpTokenizer::find_first_of(rest, "\n");
+    line = rest.substr(0, lf);
+    rest = lf == std::string_view::npos ? std::string_view{} : rest.substr(lf + 1);
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    return true;
+}
+
+static std::string_view next_token(std::string_view &rest) {
+    rest = trim(rest);
+    const size_t space = HttpTokenizer::find_first_of(rest, " ");
+    const std::string_view token = rest.substr(0, space);
+    rest = space == std::string_view::npos ? std::string_view{} : rest.substr(space + 1);
+    return token;
+}
+
+HttpRequest::HttpMethod HttpRequest::parse_http_method(const std::string_view method_str) {
     if (method_str == "GET") {
         return HttpMethod::HTTP_GET;
     }
@@ -86,69 +116,80 @@ std::string HttpRequest::http_method_to_string(HttpMethod method) {
 }
 
 bool HttpRequest::is_websocket_upgrade() const {
-    auto it_upgrade = headers.find("upgrade");
-    auto it_key = headers.find("sec-websocket-key");
+    auto it_upgrade = headers.find(HttpHeader::UPGRADE);
 
     return it_upgrade != headers.end() &&
-           it_key != headers.end() &&
-           it_upgrade->second == "websocket";
+           headers.contains(HttpHeader::SEC_WEBSOCKET_KEY) &&
+           ascii_iequals(it_upgrade->second, "websocket");
 }
 
 std::string HttpRequest::get_websocket_key() const {
-    return headers.at("sec-websocket-key");
+    return std::string{headers.at(HttpHeader::SEC_WEBSOCKET_KEY)};
 }
 
+bool HttpRequest::keep_alive() const {
+    auto it = headers.find(HttpHeader::CONNECTION);
+    const std::string_view connection = it != headers.end() ? it->second : std::string_view{};
 
-HttpRequest HttpRequest::parse_http_request(const std::string &raw_request) {
+    if (version == "HTTP/1.0") {
+        return icontains(connection, "keep-alive");
+    }
+    return !icontains(connection, "close");
+}
+
+std::string_view HttpRequest::raw() const {
+    return buffer_ ? std::string_view{*buffer_} : std::string_view{};
+}
+
+std::string_view HttpRequest::path_param(const std::string_view name) const {
+    const auto it = std::ranges::find(path_params, name, &std::pair<std::string_view, std::string_view>::first);
+    return it != path_params.end() ? it->second : std::string_view{};
+}
+
+HttpRequest HttpRequest::parse_http_request(std::string raw_request) {
     HttpRequest req;
-    std::istringstream stream(raw_request);
-    std::string line;
+    req.buffer_ = std::make_shared<const std::string>(std::move(raw_request));
+    std::string_view rest = *req.buffer_;
+    std::string_view line;
 
-    if (!std::getline(stream, line) || line.empty()) {
+    if (!next_line(rest, line) || line.empty()) {
         return req;
     }
 
-    std::istringstream req_line(line);
-    std::string method_str;
-    req_line >> method_str;
-    req.method = parse_http_method(method_str);
-
-    std::string full_path;
-    req_line >> full_path;
-    size_t qmark = full_path.find('?');
+    req.method = parse_http_method(next_token(line));
 
-    if (qmark != std::string::npos) {
+    const std::string_view full_path = next_token(line);
+    const size_t qmark = full_path.find('?');
+    if (qmark != std::string_view::npos) {
         req.path = full_path.substr(0, qmark);
-        std::string query_string = full_path.substr(qmark + 1);
-        req.query_params = parse_query_params(query_string);
+        req.query_params = parse_query_params(full_path.substr(qmark + 1));
     } else {
         req.path = full_path;
     }
 
-    req_line >> req.version;
+    req.version = next_token(line);
 
-    while (std::getline(stream, line) && line != "\r") {
-        size_t colon = line.find(':');
-        if (colon != std::string::npos) {
-            std::string key = trim(line.substr(0, colon));
-            std::string value = trim(line.substr(colon + 1));
-            if (!value.empty() && value.back() == '\r') {
-                value.pop_back();
+    while (!rest.empty()) {
+        // A single scan finds either the header colon or the end of a line without one.
+        const size_t colon = HttpTokenizer::find_first_of(rest, ":\n");
+        if (colon == std::string_view::npos) {
+            rest = {};
+            break;
+        }
+        if (rest[colon] == '\n') {
+            next_line(rest, line);
+            if (line.empty()) {
+                break;
             }
-            std::string key_lower = key;
-            std::ranges::transform(key_lower, key_lower.begin(), ::tolower);
-            req.headers[key_lower] = value;
+            continue;
         }
-    }
 
-    std::ostringstream body_stream;
-    while (std::getline(stream, line)) {
-        body_stream << line << "\n";
-    }
-    req.body = body_stream.str();
-    if (!req.body.empty() && req.body.back() == '\n') {
-        req.body.pop_back();
+        const size_t lf = HttpTokenizer::find_first_of(rest, "\n", colon + 1);
+        req.headers.set(trim(rest.substr(0, colon)), trim(rest.substr(colon + 1, lf - colon - 1)));
+        rest = lf == std::string_view::npos ? std::string_view{} : rest.substr(lf + 1);
     }
 
+    req.body = rest;
+
     return req;
 }
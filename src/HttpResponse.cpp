@@ -1,30 +1,286 @@
 #include <server/HttpResponse.hpp>
+#include <server/HttpCompression.hpp>
+#include <server/StaticAssetCache.hpp>
 
-#include <sstream>
-#include <fstream>
+#include <fcntl.h>
 #include <filesystem>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <iostream>
 #include <algorithm>
+#include <charconv>
+#include <ctime>
+#include <random>
 #include <unordered_map>
 
-std::string HttpResponse::to_string() const {
-    std::ostringstream response;
+static void append_number(std::string &out, const size_t value) {
+    char digits[20];
+    const auto [end, ec] = std::to_chars(std::begin(digits), std::end(digits), value);
+    out.append(digits, end);
+}
+
+HttpResponse::File::File(const int fd) : fd_{fd} {}
+
+HttpResponse::File::~File() { close(fd_); }
+
+int HttpResponse::File::get_fd() const { return fd_; }
+
+size_t HttpResponse::content_length() const {
+    if (file_body) {
+        return file_body->length;
+    }
+    if (!body_parts.empty()) {
+        size_t length = 0;
+        for (const auto &part: body_parts) {
+            length += part.data.size() + (part.file ? part.file->length : 0);
+        }
+        return length;
+    }
+    return body_data().size();
+}
+
+std::string_view HttpResponse::body_data() const {
+    return shared_body ? std::string_view{*shared_body} : std::string_view{body};
+}
 
-    response << version << " " << status_code << " " << status_text << "\r\n";
+void HttpResponse::serialize_head(std::string &out) const {
+    out.append(version).append(" ");
+    append_number(out, status_code);
+    out.append(" ").append(status_text).append("\r\n");
     for (const auto &[key, value]: headers) {
-        response << key << ": " << value << "\r\n";
+        out.append(key).append(": ").append(value).append("\r\n");
     }
-    if (headers.find("Content-Length") == headers.end()) {
-        response << "Content-Length: " << body.size() << "\r\n";
+    if (preserialized_headers) {
+        out.append(*preserialized_headers);
     }
-    response << "\r\n";
-    response << body;
+    const bool has_body = status_code >= 200 && status_code != 204 && status_code != 304;
+    if (has_body && !headers.contains(HttpHeader::CONTENT_LENGTH)) {
+        out.append("Content-Length: ");
+        append_number(out, content_length());
+        out.append("\r\n");
+    }
+    out.append("\r\n");
+}
 
-    return response.str();
+static void append_file(std::string &out, const HttpResponse::FileBody &file_body) {
+    const size_t start = out.size();
+    out.resize(start + file_body.length);
+    size_t done = 0;
+    while (done < file_body.length) {
+        const ssize_t n = pread(file_body.file->get_fd(), out.data() + start + done, file_body.length - done,
+                                file_body.offset + static_cast<off_t>(done));
+        if (n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    out.resize(start + done);
+}
+
+std::string HttpResponse::to_string() const {
+    std::string response;
+    serialize_head(response);
+    if (file_body) {
+        append_file(response, *file_body);
+    } else if (!body_parts.empty()) {
+        for (const auto &part: body_parts) {
+            response.append(part.data);
+            if (part.file) {
+                append_file(response, *part.file);
+            }
+        }
+    } else {
+        response.append(body_data());
+    }
+    return response;
 }
 
 void HttpResponse::set_header(const std::string &key, const std::string &value) {
-    headers[key] = value;
+    headers.set(key, value);
+}
+
+static std::string_view trim(std::string_view str) {
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+struct ByteRange {
+    size_t first;
+    size_t last;
+};
+
+static bool parse_size(const std::string_view text, size_t &value) {
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc{} && end == text.data() + text.size();
+}
+
+// Returns nullopt when the Range header has to be ignored and an empty list when no range is satisfiable.
+static std::optional<std::vector<ByteRange>> parse_byte_ranges(std::string_view header, const size_t size) {
+    static constexpr size_t MAX_RANGES = 16;
+    if (!header.starts_with("bytes=")) {
+        return std::nullopt;
+    }
+    header.remove_prefix(6);
+
+    std::vector<ByteRange> ranges;
+    size_t count = 0;
+    while (!header.empty()) {
+        const size_t comma = header.find(',');
+        const std::string_view spec = trim(header.substr(0, comma));
+        header = comma == std::string_view::npos ? std::string_view{} : header.substr(comma + 1);
+        if (spec.empty()) {
+            continue;
+        }
+        const size_t dash = spec.find('-');
+        if (++count > MAX_RANGES || dash == std::string_view::npos) {
+            return std::nullopt;
+        }
+
+        const std::string_view first_text = spec.substr(0, dash);
+        const std::string_view last_text = spec.substr(dash + 1);
+        size_t first = 0;
+        size_t last = 0;
+        if (first_text.empty()) {
+            size_t suffix = 0;
+            if (!parse_size(last_text, suffix)) {
+                return std::nullopt;
+            }
+            if (suffix == 0 || size == 0) {
+                continue;
+            }
+            first = size - std::min(suffix, size);
+            last = size - 1;
+        } else {
+            if (!parse_size(first_text, first)) {
+                return std::nullopt;
+            }
+            if (last_text.empty()) {
+                last = size - 1;
+            } else if (!parse_size(last_text, last) || last < first) {
+                return std::nullopt;
+            }
+            if (first >= size) {
+                continue;
+            }
+            last = std::min(last, size - 1);
+        }
+        ranges.push_back({first, last});
+    }
+    return ranges;
+}
+
+// If-Range requires a strong ETag match or an exact Last-Modified date.
+static bool if_range_matches(const HttpResponse &res, const std::string_view value) {
+    if (value.starts_with('"')) {
+        const auto etag = res.headers.find(HttpHeader::ETAG);
+        return etag != res.headers.end() && etag->second == value;
+    }
+    if (value.starts_with("W/")) {
+        return false;
+    }
+    const auto last_modified = res.headers.find(HttpHeader::LAST_MODIFIED);
+    if (last_modified == res.headers.end()) {
+        return false;
+    }
+    const auto since = HttpResponse::parse_http_date(value);
+    return since && since == HttpResponse::parse_http_date(last_modified->second);
+}
+
+static std::string content_range(const size_t first, const size_t last, const size_t size) {
+    std::string value = "bytes ";
+    append_number(value, first);
+    value.push_back('-');
+    append_number(value, last);
+    value.push_back('/');
+    append_number(value, size);
+    return value;
+}
+
+static std::string make_boundary() {
+    thread_local std::mt19937_64 generator{std::random_device{}()};
+    char digits[16];
+    const auto [end, ec] = std::to_chars(std::begin(digits), std::end(digits), generator(), 16);
+    return "lws-" + std::string(digits, end);
+}
+
+void HttpResponse::apply_range(const HttpRequest &req) {
+    if (status_code != 200 || !body_parts.empty()) {
+        return;
+    }
+    headers.set(HttpHeader::ACCEPT_RANGES, "bytes");
+
+    const auto range = req.headers.find(HttpHeader::RANGE);
+    if (range == req.headers.end() || req.method != HttpRequest::HttpMethod::HTTP_GET) {
+        return;
+    }
+    if (const auto if_range = req.headers.find(HttpHeader::IF_RANGE);
+        if_range != req.headers.end() && !if_range_matches(*this, if_range->second)) {
+        return;
+    }
+
+    const size_t size = content_length();
+    const auto ranges = parse_byte_ranges(range->second, size);
+    if (!ranges) {
+        return;
+    }
+
+    if (ranges->empty()) {
+        status_code = 416;
+        status_text = "Range Not Satisfiable";
+        std::string unsatisfied = "bytes */";
+        append_number(unsatisfied, size);
+        headers.set(HttpHeader::CONTENT_RANGE, unsatisfied);
+        file_body.reset();
+        shared_body.reset();
+        body.clear();
+        return;
+    }
+
+    status_code = 206;
+    status_text = "Partial Content";
+    if (ranges->size() == 1) {
+        const auto [first, last] = ranges->front();
+        headers.set(HttpHeader::CONTENT_RANGE, content_range(first, last, size));
+        if (file_body) {
+            file_body->offset += static_cast<off_t>(first);
+            file_body->length = last - first + 1;
+        } else {
+            body = std::string{body_data().substr(first, last - first + 1)};
+            shared_body.reset();
+        }
+        return;
+    }
+
+    const std::string boundary = make_boundary();
+    const auto content_type = headers.find(HttpHeader::CONTENT_TYPE);
+    const std::string part_type = content_type != headers.end() ? content_type->second : "application/octet-stream";
+    headers.set(HttpHeader::CONTENT_TYPE, "multipart/byteranges; boundary=" + boundary);
+
+    std::string text;
+    for (const auto [first, last]: *ranges) {
+        std::string part_head = "\r\n--" + boundary + "\r\nContent-Type: " + part_type +
+                                "\r\nContent-Range: " + content_range(first, last, size) + "\r\n\r\n";
+        if (file_body) {
+            body_parts.push_back({std::move(part_head),
+                                  FileBody{file_body->file, file_body->offset + static_cast<off_t>(first),
+                                           last - first + 1}});
+        } else {
+            text.append(part_head).append(body_data().substr(first, last - first + 1));
+        }
+    }
+    const std::string closing = "\r\n--" + boundary + "--\r\n";
+    if (file_body) {
+        body_parts.push_back({closing, std::nullopt});
+        file_body.reset();
+    } else {
+        body = std::move(text.append(closing));
+        shared_body.reset();
+    }
 }
 
 HttpResponse HttpResponse::Text(const std::string &body, const int status) {
@@ -54,6 +310,15 @@ HttpResponse HttpResponse::NotFound(const std::string &message) {
     return res;
 }
 
+HttpResponse HttpResponse::Error(const int status, const std::string &status_text) {
+    HttpResponse res;
+    res.status_code = status;
+    res.status_text = status_text;
+    res.body = status_text;
+    res.set_header("Content-Type", "text/plain");
+    return res;
+}
+
 HttpResponse HttpResponse::Redirect(const std::string &location, bool permanent) {
     HttpResponse res;
     res.status_code = permanent ? 301 : 302;
@@ -74,24 +339,138 @@ HttpResponse HttpResponse::Html(const std::string &html, int status) {
 }
 
 HttpResponse HttpResponse::FromFile(const std::string &file_path, const std::string &content_type) {
-    HttpResponse res;
-    std::ifstream file(file_path, std::ios::binary);
-
-    if (!file.is_open()) {
+    const int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         return NotFound("File not found: " + file_path);
     }
+    auto file = std::make_shared<const File>(fd);
 
-    std::ostringstream content;
-    content << file.rdbuf();
-    file.close();
+    struct stat st{};
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        return NotFound("File not found: " + file_path);
+    }
 
-    res.body = content.str();
+    HttpResponse res;
+    res.file_body = FileBody{std::move(file), 0, static_cast<size_t>(st.st_size)};
     res.status_code = 200;
     res.status_text = "OK";
     res.set_header("Content-Type", content_type);
+    res.headers.set(HttpHeader::ETAG, file_etag(st));
+    res.headers.set(HttpHeader::LAST_MODIFIED, http_date(st.st_mtime));
+    return res;
+}
+
+static HttpResponse FromAsset(const StaticAssetCache::Asset &asset, const HttpRequest &req) {
+    HttpResponse res;
+    res.shared_body = asset.content;
+    if (req.headers.contains(HttpHeader::RANGE)) {
+        // Range handling rewrites Content-Type and checks If-Range, so it needs the headers individually.
+        res.set_header("Content-Type", asset.mime);
+        if (!asset.content_encoding.empty()) {
+            res.headers.set(HttpHeader::CONTENT_ENCODING, asset.content_encoding);
+        }
+        res.headers.set(HttpHeader::ETAG, asset.etag);
+        res.headers.set(HttpHeader::LAST_MODIFIED, HttpResponse::http_date(asset.last_modified));
+    } else {
+        res.preserialized_headers = asset.headers;
+    }
     return res;
 }
 
+struct Precompressed {
+    std::string_view coding;
+    std::string_view extension;
+};
+
+static constexpr Precompressed PRECOMPRESSED[] = {{"br", ".br"}, {"gzip", ".gz"}};
+
+// The sidecar codings the client accepts, in preference order. Together with the files on disk this decides which
+// variant is served, so it goes into the cache key and hits need no stat.
+static std::string accepted_codings(const HttpRequest &req) {
+    std::string codings;
+    const auto accept_encoding = req.headers.find(HttpHeader::ACCEPT_ENCODING);
+    if (accept_encoding == req.headers.end()) {
+        return codings;
+    }
+    for (const auto &[coding, extension]: PRECOMPRESSED) {
+        if (HttpCompression::accepts(accept_encoding->second, coding)) {
+            if (!codings.empty()) {
+                codings.push_back(',');
+            }
+            codings.append(coding);
+        }
+    }
+    return codings;
+}
+
+static bool accepts_asset(const HttpRequest &req, const StaticAssetCache::Asset &asset) {
+    if (asset.content_encoding.empty()) {
+        return true;
+    }
+    const auto accept_encoding = req.headers.find(HttpHeader::ACCEPT_ENCODING);
+    return accept_encoding != req.headers.end() &&
+           HttpCompression::accepts(accept_encoding->second, asset.content_encoding);
+}
+
+static HttpResponse NotModified(const std::string &etag, const time_t last_modified) {
+    HttpResponse res;
+    res.status_code = 304;
+    res.status_text = "Not Modified";
+    res.headers.set(HttpHeader::ETAG, etag);
+    res.headers.set(HttpHeader::LAST_MODIFIED, HttpResponse::http_date(last_modified));
+    return res;
+}
+
+// If-None-Match uses the weak comparison function, so W/"x" matches "x".
+static bool etag_matches(const std::string_view candidates, std::string_view etag) {
+    if (etag.starts_with("W/")) {
+        etag.remove_prefix(2);
+    }
+    size_t pos = 0;
+    while (pos <= candidates.size()) {
+        size_t end = candidates.find(',', pos);
+        if (end == std::string_view::npos) {
+            end = candidates.size();
+        }
+        std::string_view candidate = trim(candidates.substr(pos, end - pos));
+        if (candidate == "*") {
+            return true;
+        }
+        if (candidate.starts_with("W/")) {
+            candidate.remove_prefix(2);
+        }
+        if (candidate == etag) {
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+static bool is_not_modified(const HttpRequest &req, const std::string_view etag, const time_t last_modified) {
+    if (req.method != HttpRequest::HttpMethod::HTTP_GET && req.method != HttpRequest::HttpMethod::HTTP_HEAD) {
+        return false;
+    }
+    if (const auto it = req.headers.find(HttpHeader::IF_NONE_MATCH); it != req.headers.end()) {
+        return etag_matches(it->second, etag);
+    }
+    if (const auto it = req.headers.find(HttpHeader::IF_MODIFIED_SINCE); it != req.headers.end()) {
+        const auto since = HttpResponse::parse_http_date(it->second);
+        return since && last_modified <= *since;
+    }
+    return false;
+}
+
+static const std::string *find_cache_control(const ServeStaticOptions &options, const std::string_view path) {
+    const CacheControlRule *best = nullptr;
+    for (const auto &rule: options.cache_control) {
+        if (path.starts_with(rule.prefix) && (!best || rule.prefix.size() > best->prefix.size())) {
+            best = &rule;
+        }
+    }
+    return best ? &best->value : nullptr;
+}
+
 static std::string detect_mime(std::string ext) {
     std::ranges::transform(ext, ext.begin(), ::tolower);
 
@@ -112,17 +491,43 @@ static std::string detect_mime(std::string ext) {
 }
 
 HttpResponse HttpResponse::ServeStatic(const std::filesystem::path &base_path, const HttpRequest &req,
-                                       const std::string &route_prefix) {
+                                       const std::string &route_prefix, const ServeStaticOptions &options) {
     if (!req.path.starts_with(route_prefix)) {
-        return NotFound("Invalid static path: " + req.path);
+        return NotFound("Invalid static path: " + std::string{req.path});
     }
 
-    std::string relative = req.path.substr(route_prefix.length());
+    std::string relative{req.path.substr(route_prefix.length())};
     if (!relative.empty() && relative[0] == '/')
         relative.erase(0, 1);
     if (relative.empty())
         relative = "index.html";
 
+    const std::string *cache_control = find_cache_control(options, req.path);
+    const std::string codings = options.precompressed ? accepted_codings(req) : std::string{};
+    auto finish = [cache_control, &req, &options](HttpResponse res) {
+        res.apply_range(req);
+        if (cache_control) {
+            res.headers.set(HttpHeader::CACHE_CONTROL, *cache_control);
+        }
+        if (options.precompressed) {
+            res.headers.set(HttpHeader::VARY, "Accept-Encoding");
+        }
+        return res;
+    };
+
+    std::string cache_key;
+    if (options.cache) {
+        cache_key.append(base_path.native()).push_back('\0');
+        cache_key.append(relative).push_back('\0');
+        cache_key.append(codings);
+        if (const auto asset = options.cache->find(cache_key); asset && accepts_asset(req, *asset)) {
+            if (is_not_modified(req, asset->etag, asset->last_modified)) {
+                return finish(NotModified(asset->etag, asset->last_modified));
+            }
+            return finish(FromAsset(*asset, req));
+        }
+    }
+
     std::filesystem::path requested_path = base_path / relative;
 
     std::error_code ec;
@@ -141,7 +546,8 @@ HttpResponse HttpResponse::ServeStatic(const std::filesystem::path &base_path, c
         }
     }
 
-    if (!exists(normalized_path) || is_directory(normalized_path)) {
+    struct stat st{};
+    if (stat(normalized_path.c_str(), &st) < 0 || !S_ISREG(st.st_mode)) {
         return NotFound("File not found: " + relative);
     }
 
@@ -149,16 +555,86 @@ HttpResponse HttpResponse::ServeStatic(const std::filesystem::path &base_path, c
     std::ranges::transform(ext, ext.begin(), ::tolower);
     std::string mime = detect_mime(ext);
 
-    return FromFile(normalized_path.string(), mime);
+    std::string content_encoding;
+    if (!codings.empty()) {
+        const auto &accept_encoding = req.headers.find(HttpHeader::ACCEPT_ENCODING)->second;
+        for (const auto &[candidate, extension]: PRECOMPRESSED) {
+            std::filesystem::path sidecar = normalized_path;
+            sidecar += extension;
+            struct stat sidecar_st{};
+            if (HttpCompression::accepts(accept_encoding, candidate) && stat(sidecar.c_str(), &sidecar_st) == 0 &&
+                S_ISREG(sidecar_st.st_mode)) {
+                normalized_path = std::move(sidecar);
+                st = sidecar_st;
+                content_encoding = candidate;
+                break;
+            }
+        }
+    }
+
+    const std::string etag = file_etag(st);
+    if (is_not_modified(req, etag, st.st_mtime)) {
+        return finish(NotModified(etag, st.st_mtime));
+    }
+
+    if (options.cache) {
+        if (const auto asset = options.cache->load(std::move(cache_key), normalized_path, mime, content_encoding)) {
+            return finish(FromAsset(*asset, req));
+        }
+    }
+
+    HttpResponse res = FromFile(normalized_path.string(), mime);
+    if (!content_encoding.empty() && res.status_code == 200) {
+        res.headers.set(HttpHeader::CONTENT_ENCODING, content_encoding);
+    }
+    return finish(std::move(res));
 }
 
-HttpResponse HttpResponse::WebSocketSwitchingProtocols(const std::string &websocket_handshake_key) {
+HttpResponse HttpResponse::WebSocketSwitchingProtocols(const std::string &websocket_handshake_key,
+                                                       const std::string &extensions) {
     HttpResponse res;
     res.status_code = 101;
     res.status_text = "Switching Protocols";
     res.set_header("Upgrade", "websocket");
     res.set_header("Connection", "Upgrade");
     res.set_header("Sec-WebSocket-Accept", websocket_handshake_key);
+    if (!extensions.empty()) {
+        res.set_header("Sec-WebSocket-Extensions", extensions);
+    }
     res.body = "";
     return res;
 }
+
+std::string HttpResponse::file_etag(const struct stat &st) {
+    const uint64_t mtime_ns = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    const uint64_t parts[] = {st.st_ino, static_cast<uint64_t>(st.st_size), mtime_ns};
+    std::string etag = "\"";
+    for (const uint64_t part: parts) {
+        char digits[16];
+        const auto [end, ec] = std::to_chars(std::begin(digits), std::end(digits), part, 16);
+        if (etag.size() > 1) {
+            etag.push_back('-');
+        }
+        etag.append(digits, end);
+    }
+    etag.push_back('"');
+    return etag;
+}
+
+std::string HttpResponse::http_date(const time_t time) {
+    tm parts{};
+    gmtime_r(&time, &parts);
+    char date[32];
+    const size_t size = strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &parts);
+    return {date, size};
+}
+
+std::optional<time_t> HttpResponse::parse_http_date(const std::string_view date) {
+    const std::string terminated{date};
+    tm parts{};
+    const char *end = strptime(terminated.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &parts);
+    if (!end || *end != '\0') {
+        return std::nullopt;
+    }
+    return timegm(&parts);
+}
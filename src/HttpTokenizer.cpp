@@ -0,0 +1,158 @@
+#include <server/HttpTokenizer.hpp>
+
+#include <array>
+#include <atomic>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LWS_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+using FindFn = size_t (*)(const char *, size_t, std::string_view);
+
+static size_t find_scalar(const char *data, const size_t size, const std::string_view delimiters) {
+  std::array<bool, 256> is_delimiter{};
+  for (const char c : delimiters) {
+    is_delimiter[static_cast<unsigned char>(c)] = true;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    if (is_delimiter[static_cast<unsigned char>(data[i])]) {
+      return i;
+    }
+  }
+  return std::string_view::npos;
+}
+
+#ifdef LWS_X86_SIMD
+__attribute__((target("sse4.2"))) static size_t find_sse42(const char *data, const size_t size,
+                                                           const std::string_view delimiters) {
+  alignas(16) char set[16] = {};
+  delimiters.copy(set, sizeof(set));
+  const __m128i needles = _mm_load_si128(reinterpret_cast<const __m128i *>(set));
+  const int needles_len = static_cast<int>(delimiters.size());
+
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    const int index = _mm_cmpestri(needles, needles_len, block, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY);
+    if (index < 16) {
+      return i + index;
+    }
+  }
+  const size_t tail = find_scalar(data + i, size - i, delimiters);
+  return tail == std::string_view::npos ? tail : i + tail;
+}
+
+__attribute__((target("avx2"))) static size_t find_avx2(const char *data, const size_t size,
+                                                        const std::string_view delimiters) {
+  __m256i needles[HttpTokenizer::MAX_DELIMITERS];
+  for (size_t d = 0; d < delimiters.size(); ++d) {
+    needles[d] = _mm256_set1_epi8(delimiters[d]);
+  }
+
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    __m256i matches = _mm256_cmpeq_epi8(block, needles[0]);
+    for (size_t d = 1; d < delimiters.size(); ++d) {
+      matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(block, needles[d]));
+    }
+    if (const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(matches)); mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  const size_t tail = find_scalar(data + i, size - i, delimiters);
+  return tail == std::string_view::npos ? tail : i + tail;
+}
+#endif
+
+static HttpTokenizer::Implementation detect_implementation() {
+#ifdef LWS_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return HttpTokenizer::Implementation::AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.2")) {
+    return HttpTokenizer::Implementation::SSE42;
+  }
+#endif
+  return HttpTokenizer::Implementation::SCALAR;
+}
+
+static FindFn to_function(const HttpTokenizer::Implementation implementation) {
+  switch (implementation) {
+#ifdef LWS_X86_SIMD
+  case HttpTokenizer::Implementation::AVX2:
+    return find_avx2;
+  case HttpTokenizer::Implementation::SSE42:
+    return find_sse42;
+#endif
+  default:
+    return find_scalar;
+  }
+}
+
+static size_t find_unresolved(const char *data, size_t size, std::string_view delimiters);
+
+// Constant-initialized so the parser can run from other translation units' static constructors.
+static constinit std::atomic<FindFn> active_find{find_unresolved};
+static constinit std::atomic<HttpTokenizer::Implementation> active_implementation{
+    HttpTokenizer::Implementation::SCALAR};
+
+static FindFn resolve_implementation() {
+  FindFn expected = find_unresolved;
+  const HttpTokenizer::Implementation detected = detect_implementation();
+  if (active_find.compare_exchange_strong(expected, to_function(detected))) {
+    active_implementation.store(detected);
+    return to_function(detected);
+  }
+  return expected;
+}
+
+static size_t find_unresolved(const char *data, const size_t size, const std::string_view delimiters) {
+  return resolve_implementation()(data, size, delimiters);
+}
+
+size_t HttpTokenizer::find_first_of(const std::string_view str, const std::string_view delimiters, const size_t pos) {
+  if (pos >= str.size() || delimiters.empty()) {
+    return std::string_view::npos;
+  }
+  if (delimiters.size() > MAX_DELIMITERS) {
+    throw std::invalid_argument("HttpTokenizer supports at most 16 delimiters");
+  }
+  const size_t found = active_find.load(std::memory_order_relaxed)(str.data() + pos, str.size() - pos, delimiters);
+  return found == std::string_view::npos ? found : pos + found;
+}
+
+HttpTokenizer::Implementation HttpTokenizer::implementation() {
+  resolve_implementation();
+  return active_implementation.load();
+}
+
+void HttpTokenizer::set_implementation(const Implementation implementation) {
+  if (!is_supported(implementation)) {
+    throw std::runtime_error("HttpTokenizer implementation is not supported by this CPU");
+  }
+  resolve_implementation();
+  active_implementation.store(implementation);
+  active_find.store(to_function(implementation));
+}
+
+bool HttpTokenizer::is_supported(const Implementation implementation) {
+#ifdef LWS_X86_SIMD
+  __builtin_cpu_init();
+#endif
+  switch (implementation) {
+  case Implementation::SCALAR:
+    return true;
+#ifdef LWS_X86_SIMD
+  case Implementation::SSE42:
+    return __builtin_cpu_supports("sse4.2");
+  case Implementation::AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
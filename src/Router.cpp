@@ -0,0 +1,150 @@
+#include <server/Router.hpp>
+
+#include <stdexcept>
+
+void Router::add(const HttpRequest::HttpMethod method, const std::string_view route, Handler handler) {
+  add_route(method, route, Route{.handler = std::move(handler), .async_handler = nullptr});
+}
+
+void Router::add(const HttpRequest::HttpMethod method, const std::string_view route, AsyncHandler handler) {
+  add_route(method, route, Route{.handler = nullptr, .async_handler = std::move(handler)});
+}
+
+void Router::add_route(const HttpRequest::HttpMethod method, const std::string_view route, Route target) {
+  if (method == HttpRequest::HttpMethod::HTTP_UNKNOWN) {
+    throw std::invalid_argument("Cannot register a route for an unknown HTTP method");
+  }
+  insert(roots_[static_cast<size_t>(method)], route, std::move(target));
+}
+
+const Router::Route *Router::match(HttpRequest &req) const {
+  req.path_params.clear();
+  if (req.method == HttpRequest::HttpMethod::HTTP_UNKNOWN) {
+    return nullptr;
+  }
+
+  Params params;
+  Candidate best;
+  if (const Route *target = match(roots_[static_cast<size_t>(req.method)], req.path, 0, params, best)) {
+    req.path_params = std::move(params);
+    return target;
+  }
+  req.path_params = std::move(best.params);
+  return best.target;
+}
+
+void Router::insert(Node &node, const std::string_view route, Route target) {
+  if (route.empty()) {
+    node.target = std::move(target);
+    return;
+  }
+
+  if (route.front() == ':') {
+    const size_t end = std::min(route.find('/'), route.size());
+    const std::string_view name = route.substr(1, end - 1);
+    if (name.empty()) {
+      throw std::invalid_argument("Route parameter must have a name");
+    }
+    if (!node.param_child) {
+      node.param_child = std::make_unique<Node>();
+      node.param_name = name;
+    } else if (node.param_name != name) {
+      throw std::invalid_argument("Conflicting route parameter names :" + node.param_name + " and :" +
+                                  std::string{name});
+    }
+    insert(*node.param_child, route.substr(end), std::move(target));
+    return;
+  }
+
+  if (route.front() == '*') {
+    const std::string_view name = route.substr(1);
+    if (name.find('/') != std::string_view::npos) {
+      throw std::invalid_argument("Wildcard must be the last segment of a route");
+    }
+    if (!node.wildcard_child) {
+      node.wildcard_child = std::make_unique<Node>();
+      node.wildcard_name = name;
+    } else if (node.wildcard_name != name) {
+      throw std::invalid_argument("Conflicting route wildcard names *" + node.wildcard_name + " and *" +
+                                  std::string{name});
+    }
+    node.wildcard_child->target = std::move(target);
+    return;
+  }
+
+  const size_t label_end = std::min(route.find_first_of(":*"), route.size());
+  Node &child = static_child(node, route.substr(0, label_end));
+  insert(child, route.substr(label_end), std::move(target));
+}
+
+Router::Node &Router::static_child(Node &node, const std::string_view label) {
+  const size_t index = node.indices.find(label.front());
+  if (index == std::string::npos) {
+    auto child = std::make_unique<Node>();
+    child->prefix = label;
+    node.indices.push_back(label.front());
+    node.children.push_back(std::move(child));
+    return *node.children.back();
+  }
+
+  Node &child = *node.children[index];
+  size_t common = 0;
+  while (common < label.size() && common < child.prefix.size() && label[common] == child.prefix[common]) {
+    ++common;
+  }
+
+  if (common < child.prefix.size()) {
+    // Split the edge: the existing child keeps the tail of its label under a new intermediate node.
+    auto tail = std::make_unique<Node>(std::move(child));
+    tail->prefix.erase(0, common);
+    child = Node{};
+    child.prefix = label.substr(0, common);
+    child.indices.push_back(tail->prefix.front());
+    child.children.push_back(std::move(tail));
+  }
+
+  if (common == label.size()) {
+    return child;
+  }
+  return static_child(child, label.substr(common));
+}
+
+const Router::Route *Router::match(const Node &node, const std::string_view path, const size_t consumed,
+                                     Params &params, Candidate &best) {
+  if (path.empty()) {
+    if (node.target) {
+      return &node.target;
+    }
+  } else if (node.target && consumed > 0 && consumed > best.consumed) {
+    best = Candidate{&node.target, consumed, params};
+  }
+
+  if (!path.empty()) {
+    if (const size_t index = node.indices.find(path.front()); index != std::string::npos) {
+      const Node &child = *node.children[index];
+      if (path.starts_with(child.prefix)) {
+        if (const Route *target =
+                match(child, path.substr(child.prefix.size()), consumed + child.prefix.size(), params, best)) {
+          return target;
+        }
+      }
+    }
+
+    if (node.param_child) {
+      const size_t end = std::min(path.find('/'), path.size());
+      if (end > 0) {
+        params.emplace_back(node.param_name, path.substr(0, end));
+        if (const Route *target = match(*node.param_child, path.substr(end), consumed + end, params, best)) {
+          return target;
+        }
+        params.pop_back();
+      }
+    }
+  }
+
+  if (node.wildcard_child) {
+    params.emplace_back(node.wildcard_name, path);
+    return &node.wildcard_child->target;
+  }
+  return nullptr;
+}
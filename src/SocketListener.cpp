@@ -22,11 +22,20 @@ void SocketListener::add_socket(const int fd, const uint32_t events) {
   }
 }
 
+void SocketListener::modify_socket(const int fd, const uint32_t events) const {
+  epoll_event ev;
+  ev.events = events;
+  ev.data.fd = fd;
+
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) < 0) {
+    throw std::runtime_error(std::string("epoll_ctl MOD failed: ") + strerror(errno));
+  }
+}
+
 void SocketListener::remove_socket(const int fd) const { epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr); }
 
 void SocketListener::run() {
-  running_ = true;
-  while (running_) {
+  while (!stopped_) {
     const int n = epoll_wait(epoll_fd_, events_.data(), parameters_.max_events, parameters_.epoll_timeout);
     if (n < 0) {
       if (errno == EINTR)
@@ -43,7 +52,7 @@ void SocketListener::run() {
   }
 }
 
-void SocketListener::stop() { running_ = false; }
+void SocketListener::stop() { stopped_ = true; }
 
 void SocketListener::make_non_blocking(int fd) {
   int flags = fcntl(fd, F_GETFL, 0);
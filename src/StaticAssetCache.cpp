@@ -0,0 +1,250 @@
+#include <server/StaticAssetCache.hpp>
+#include <server/HttpResponse.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <ranges>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr uint32_t WATCH_MASK = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE |
+                                       IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+StaticAssetCache::StaticAssetCache(Parameters parameters) : parameters_{parameters} {
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0) {
+    throw std::runtime_error(std::string("inotify_init1 failed: ") + strerror(errno));
+  }
+  watch_thread_ = std::jthread{[this](const std::stop_token &token) { watch_loop(token); }};
+}
+
+StaticAssetCache::~StaticAssetCache() {
+  watch_thread_.request_stop();
+  if (watch_thread_.joinable()) {
+    watch_thread_.join();
+  }
+  close(inotify_fd_);
+}
+
+std::shared_ptr<const StaticAssetCache::Asset> StaticAssetCache::find(const std::string_view request_key) {
+  std::scoped_lock lock(mtx_);
+  const auto key_it = request_keys_.find(request_key);
+  if (key_it == request_keys_.end()) {
+    return nullptr;
+  }
+  const auto it = entries_.find(key_it->second);
+  if (it == entries_.end()) {
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+  return it->second.asset;
+}
+
+std::shared_ptr<const StaticAssetCache::Asset>
+StaticAssetCache::load(std::string request_key, const std::filesystem::path &canonical_path, const std::string &mime,
+                       const std::string &content_encoding) {
+  const uint64_t epoch = invalidation_epoch_.load();
+  if (!watch_directory(canonical_path.parent_path())) {
+    return nullptr;
+  }
+
+  const int fd = open(canonical_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st{};
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || static_cast<size_t>(st.st_size) > parameters_.max_asset_size ||
+      static_cast<size_t>(st.st_size) > parameters_.memory_budget) {
+    close(fd);
+    return nullptr;
+  }
+
+  auto content = std::make_shared<std::string>(static_cast<size_t>(st.st_size), '\0');
+  size_t done = 0;
+  while (done < content->size()) {
+    const ssize_t n = pread(fd, content->data() + done, content->size() - done, static_cast<off_t>(done));
+    if (n <= 0) {
+      break;
+    }
+    done += n;
+  }
+  close(fd);
+  if (done != content->size()) {
+    return nullptr;
+  }
+
+  auto asset = std::make_shared<Asset>();
+  asset->path = canonical_path;
+  asset->content = std::move(content);
+  asset->mime = mime;
+  asset->content_encoding = content_encoding;
+  asset->etag = HttpResponse::file_etag(st);
+  asset->last_modified = st.st_mtime;
+  std::string headers = "Content-Type: " + mime + "\r\n";
+  if (!content_encoding.empty()) {
+    headers.append("Content-Encoding: ").append(content_encoding).append("\r\n");
+  }
+  headers.append("ETag: ").append(asset->etag).append("\r\n");
+  headers.append("Last-Modified: ").append(HttpResponse::http_date(asset->last_modified)).append("\r\n");
+  asset->headers = std::make_shared<const std::string>(std::move(headers));
+
+  std::scoped_lock lock(mtx_);
+  if (invalidation_epoch_.load() != epoch) {
+    return asset;
+  }
+
+  const std::string canonical = canonical_path.string();
+  unlink_request_key_locked(request_key, canonical);
+  if (const auto it = entries_.find(canonical); it != entries_.end()) {
+    if (std::ranges::find(it->second.request_keys, request_key) == it->second.request_keys.end()) {
+      it->second.request_keys.push_back(request_key);
+    }
+    request_keys_.insert_or_assign(std::move(request_key), canonical);
+    return it->second.asset;
+  }
+
+  lru_.push_front(canonical);
+  entries_.emplace(canonical, Entry{asset, lru_.begin(), {request_key}});
+  request_keys_.insert_or_assign(std::move(request_key), canonical);
+  memory_usage_ += asset->content->size();
+
+  while (memory_usage_ > parameters_.memory_budget && lru_.size() > 1) {
+    erase_locked(lru_.back());
+  }
+  return asset;
+}
+
+void StaticAssetCache::invalidate(const std::filesystem::path &canonical_path) {
+  std::scoped_lock lock(mtx_);
+  erase_locked(canonical_path.string());
+}
+
+size_t StaticAssetCache::memory_usage() const {
+  std::scoped_lock lock(mtx_);
+  return memory_usage_;
+}
+
+size_t StaticAssetCache::size() const {
+  std::scoped_lock lock(mtx_);
+  return entries_.size();
+}
+
+void StaticAssetCache::watch_loop(const std::stop_token &token) {
+  alignas(inotify_event) char buffer[16 * 1024];
+  while (!token.stop_requested()) {
+    pollfd readable{inotify_fd_, POLLIN, 0};
+    if (poll(&readable, 1, parameters_.poll_timeout) <= 0) {
+      continue;
+    }
+
+    const ssize_t n = read(inotify_fd_, buffer, sizeof(buffer));
+    for (ssize_t offset = 0; offset < n;) {
+      const auto *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+      offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+      invalidation_epoch_.fetch_add(1);
+
+      // Events were lost, so nothing cached can be trusted; overflow events carry no watch descriptor.
+      if (event->mask & IN_Q_OVERFLOW) {
+        clear();
+        continue;
+      }
+
+      std::filesystem::path directory;
+      {
+        std::scoped_lock lock(mtx_);
+        const auto it = watches_.find(event->wd);
+        if (it == watches_.end()) {
+          continue;
+        }
+        directory = it->second;
+        if (event->mask & IN_IGNORED) {
+          watched_directories_.erase(directory.string());
+          watches_.erase(it);
+        }
+      }
+
+      if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+        invalidate_directory(directory);
+      } else if (event->len > 0) {
+        const std::filesystem::path changed = directory / event->name;
+        if (event->mask & IN_ISDIR) {
+          invalidate_directory(changed);
+        } else {
+          invalidate(changed);
+          // A new or removed sidecar changes which variant the original's request keys should resolve to.
+          if (changed.extension() == ".gz" || changed.extension() == ".br") {
+            invalidate(std::filesystem::path{changed}.replace_extension());
+          }
+        }
+      }
+    }
+  }
+}
+
+bool StaticAssetCache::watch_directory(const std::filesystem::path &directory) {
+  {
+    std::scoped_lock lock(mtx_);
+    if (watched_directories_.contains(directory.string())) {
+      return true;
+    }
+  }
+  const int wd = inotify_add_watch(inotify_fd_, directory.c_str(), WATCH_MASK);
+  if (wd < 0) {
+    return false;
+  }
+  std::scoped_lock lock(mtx_);
+  watches_.insert_or_assign(wd, directory);
+  watched_directories_.insert_or_assign(directory.string(), wd);
+  return true;
+}
+
+void StaticAssetCache::clear() {
+  std::scoped_lock lock(mtx_);
+  entries_.clear();
+  request_keys_.clear();
+  lru_.clear();
+  memory_usage_ = 0;
+}
+
+void StaticAssetCache::unlink_request_key_locked(const std::string &request_key, const std::string &canonical_path) {
+  const auto key_it = request_keys_.find(request_key);
+  if (key_it == request_keys_.end() || key_it->second == canonical_path) {
+    return;
+  }
+  if (const auto it = entries_.find(key_it->second); it != entries_.end()) {
+    std::erase(it->second.request_keys, request_key);
+  }
+  request_keys_.erase(key_it);
+}
+
+void StaticAssetCache::erase_locked(const std::string &canonical_path) {
+  const auto it = entries_.find(canonical_path);
+  if (it == entries_.end()) {
+    return;
+  }
+  for (const auto &request_key : it->second.request_keys) {
+    request_keys_.erase(request_key);
+  }
+  memory_usage_ -= it->second.asset->content->size();
+  lru_.erase(it->second.lru_position);
+  entries_.erase(it);
+}
+
+void StaticAssetCache::invalidate_directory(const std::filesystem::path &directory) {
+  const std::string prefix = directory.string() + "/";
+  std::scoped_lock lock(mtx_);
+  std::vector<std::string> stale;
+  for (const auto &canonical_path : entries_ | std::views::keys) {
+    if (canonical_path.starts_with(prefix)) {
+      stale.push_back(canonical_path);
+    }
+  }
+  for (const auto &canonical_path : stale) {
+    erase_locked(canonical_path);
+  }
+}
@@ -0,0 +1,69 @@
+#include <server/ThreadPlacement.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+
+// First CPU id of a sysfs cpulist such as "0,64" or "2-3".
+static int first_cpu_in_list(const std::string &list) {
+  int cpu = -1;
+  for (const char c : list) {
+    if (c < '0' || c > '9') {
+      break;
+    }
+    cpu = (cpu < 0 ? 0 : cpu * 10) + (c - '0');
+  }
+  return cpu;
+}
+
+std::vector<int> ThreadPlacement::resolve(const Affinity &affinity) {
+  if (!affinity.cpus.empty()) {
+    return affinity.cpus;
+  }
+  return affinity.physical_cores ? physical_cores() : std::vector<int>{};
+}
+
+std::vector<int> ThreadPlacement::physical_cores() {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return {};
+  }
+
+  std::vector<int> cores;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (!CPU_ISSET(cpu, &allowed)) {
+      continue;
+    }
+    std::ifstream siblings("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+    std::string list;
+    // Without topology information every CPU counts as its own core.
+    if (!std::getline(siblings, list) || first_cpu_in_list(list) == cpu || first_cpu_in_list(list) < 0) {
+      cores.push_back(cpu);
+    }
+  }
+  return cores;
+}
+
+int ThreadPlacement::cpu_for(const std::vector<int> &cpus, const size_t index) {
+  return cpus.empty() ? -1 : cpus[index % cpus.size()];
+}
+
+void ThreadPlacement::apply(const int cpu, const std::string &name) {
+  pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+  if (cpu < 0) {
+    return;
+  }
+  if (cpu >= CPU_SETSIZE) {
+    std::cerr << "Failed to pin thread " << name << ": CPU " << cpu << " is out of range" << std::endl;
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (const int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); error != 0) {
+    std::cerr << "Failed to pin thread " << name << " to CPU " << cpu << ": " << strerror(error) << std::endl;
+  }
+}
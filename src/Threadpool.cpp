@@ -1,76 +1,287 @@
 #include <iostream>
 #include <server/Threadpool.hpp>
 
-Threadpool::Threadpool(const size_t num_threads) {
-  for (size_t i = 0; i < num_threads; ++i) {
-    workers_.emplace_back([this](const std::stop_token &stoken) { worker_loop(stoken); });
+struct CurrentWorker {
+  const void *pool{nullptr};
+  void *worker{nullptr};
+};
+
+static thread_local CurrentWorker current_worker;
+
+static int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static void run(Job &task) {
+  try {
+    if (task) {
+      task();
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Threadpool task threw exception: " << e.what() << std::endl;
+  } catch (...) {
+    std::cerr << "Threadpool task threw unknown exception" << std::endl;
   }
 }
 
+void Threadpool::TaskRing::push(Task task) {
+  if (size_ == tasks_.size()) {
+    std::vector<Task> grown(std::max<size_t>(64, tasks_.size() * 2));
+    for (size_t i = 0; i < size_; ++i) {
+      grown[i] = std::move(tasks_[(head_ + i) % tasks_.size()]);
+    }
+    tasks_ = std::move(grown);
+    head_ = 0;
+  }
+  tasks_[(head_ + size_) % tasks_.size()] = std::move(task);
+  ++size_;
+}
+
+Threadpool::Task Threadpool::TaskRing::pop() {
+  Task task = std::move(tasks_[head_]);
+  head_ = (head_ + 1) % tasks_.size();
+  --size_;
+  return task;
+}
+
+Threadpool::Worker::Worker(const size_t index) : rng_state{0x9E3779B97F4A7C15ull * (index + 1)} {}
+
+Threadpool::Threadpool(const size_t num_threads) : Threadpool(Parameters{.num_threads = num_threads}) {}
+
+Threadpool::Threadpool(const Parameters &parameters)
+    : admission_{parameters.admission}, workers_(parameters.num_threads),
+      workers_ready_{static_cast<ptrdiff_t>(parameters.num_threads) + 1} {
+  const std::vector<int> cpus = ThreadPlacement::resolve(parameters.affinity);
+  for (size_t i = 0; i < parameters.num_threads; ++i) {
+    threads_.emplace_back([this, i, cpu = ThreadPlacement::cpu_for(cpus, i),
+                           name = parameters.name + "-" + std::to_string(i)] { worker_main(i, cpu, name); });
+  }
+  workers_ready_.arrive_and_wait();
+}
+
 Threadpool::~Threadpool() {
-  {
-    std::scoped_lock lock(mtx_);
-    shutdown_ = true;
+  request_stop();
+  wait_for_exit();
+}
+
+bool Threadpool::submit(Job job) {
+  if (shutdown_.load()) {
+    std::cerr << "Threadpool::submit() called on shutdown" << std::endl;
+    return false;
   }
-  cv_.notify_all();
+  Worker *worker = local_worker();
+  if (!admit(worker != nullptr)) {
+    return false;
+  }
+  Task task{std::move(job), admission_.policy == AdmissionPolicy::CODEL ? now_ns() : 0};
+  if (!worker || !push_local(*worker, task)) {
+    std::scoped_lock lock(injection_mtx_);
+    injection_.push(std::move(task));
+    injected_.fetch_add(1);
+  }
+  wake_one();
+  return true;
 }
 
-void Threadpool::submit(std::function<void()> task) {
-  {
-    std::scoped_lock lock(mtx_);
-    if (shutdown_) {
-      std::cerr << "Threadpool::submit() called on shutdown" << std::endl;
-      return;
+bool Threadpool::admit(const bool local) {
+  size_t pending = pending_.load();
+  if (!local && admission_.policy == AdmissionPolicy::CODEL && pending > 0 && overloaded_.load()) {
+    return false;
+  }
+  while (true) {
+    if (local || admission_.capacity == 0 || pending < admission_.capacity) {
+      if (pending_.compare_exchange_weak(pending, pending + 1)) {
+        return true;
+      }
+      continue;
+    }
+    if (admission_.policy != AdmissionPolicy::BLOCK || shutdown_.load()) {
+      return false;
     }
-    tasks_.push(std::move(task));
+    // Workers keep draining during shutdown, so a blocked submitter always wakes up.
+    blocked_.fetch_add(1);
+    pending_.wait(pending);
+    blocked_.fetch_sub(1);
+    pending = pending_.load();
   }
-  cv_.notify_one();
 }
 
-void Threadpool::request_stop() {
-  {
-    std::scoped_lock lock(mtx_);
-    shutdown_ = true;
+void Threadpool::on_dequeue(const Task &task) {
+  pending_.fetch_sub(1);
+  if (blocked_.load() > 0) {
+    pending_.notify_one();
   }
-  cv_.notify_all();
-  for (auto &worker : workers_) {
-    if (worker.joinable()) {
-      worker.request_stop();
-    }
+  if (admission_.policy != AdmissionPolicy::CODEL) {
+    return;
+  }
+
+  const int64_t now = now_ns();
+  const int64_t delay = now - task.enqueued_at;
+  int64_t minimum = interval_min_delay_.load(std::memory_order_relaxed);
+  while (delay < minimum && !interval_min_delay_.compare_exchange_weak(minimum, delay, std::memory_order_relaxed)) {
+  }
+
+  // A standing queue is one whose best-case delay over a whole interval still misses the target.
+  int64_t start = interval_start_.load(std::memory_order_relaxed);
+  if (now - start >= std::chrono::nanoseconds{admission_.interval}.count() &&
+      interval_start_.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+    const int64_t window_minimum = interval_min_delay_.exchange(INT64_MAX, std::memory_order_relaxed);
+    overloaded_.store(window_minimum > std::chrono::nanoseconds{admission_.target}.count());
   }
 }
 
+void Threadpool::request_stop() {
+  shutdown_.store(true);
+  wake_epoch_.fetch_add(1);
+  wake_epoch_.notify_all();
+}
 
 void Threadpool::wait_for_exit() {
-  for (auto &worker : workers_) {
-    if (worker.joinable()) {
-      worker.join();
+  for (auto &thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
     }
   }
 }
 
-void Threadpool::worker_loop(const std::stop_token &stoken) {
-  while (true) {
-    std::function<void()> task;
-    {
-      std::unique_lock lock(mtx_);
-      cv_.wait(lock, stoken, [this] { return shutdown_ || !tasks_.empty(); });
+void Threadpool::worker_main(const size_t index, const int cpu, const std::string &name) {
+  ThreadPlacement::apply(cpu, name);
+  workers_[index] = std::make_unique<Worker>(index);
+  // Nobody steals or submits locally until every deque exists.
+  workers_ready_.arrive_and_wait();
+  worker_loop(*workers_[index]);
+}
 
-      if (shutdown_ && tasks_.empty()) {
+void Threadpool::worker_loop(Worker &self) {
+  current_worker = {this, &self};
+  while (true) {
+    Task task;
+    if (const auto slot = self.deque.pop()) {
+      task = take(**slot);
+    } else if (!take_injected(self, task) && !steal(self, task)) {
+      if (shutdown_.load() && !has_work()) {
         return;
       }
+      // An empty queue is not a standing queue.
+      overloaded_.store(false);
+      interval_min_delay_.store(INT64_MAX, std::memory_order_relaxed);
+      park();
+      continue;
+    }
+    on_dequeue(task);
+    run(task.job);
+  }
+}
+
+Threadpool::Worker *Threadpool::local_worker() const {
+  return current_worker.pool == this ? static_cast<Worker *>(current_worker.worker) : nullptr;
+}
+
+Threadpool::Slot *Threadpool::acquire_slot(Worker &worker) {
+  for (size_t i = 0; i < WORKER_CAPACITY; ++i) {
+    Slot &slot = worker.slots[(worker.next_slot + i) % WORKER_CAPACITY];
+    if (!slot.busy.load(std::memory_order_acquire)) {
+      worker.next_slot = (worker.next_slot + i + 1) % WORKER_CAPACITY;
+      slot.busy.store(true, std::memory_order_relaxed);
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+Threadpool::Task Threadpool::take(Slot &slot) {
+  Task task = std::move(slot.task);
+  slot.task.job = nullptr;
+  slot.busy.store(false, std::memory_order_release);
+  return task;
+}
 
-      task = std::move(tasks_.front());
-      tasks_.pop();
+bool Threadpool::push_local(Worker &worker, Task &task) {
+  Slot *slot = acquire_slot(worker);
+  if (!slot) {
+    return false;
+  }
+  slot->task = std::move(task);
+  worker.deque.push(slot);
+  return true;
+}
+
+bool Threadpool::take_injected(Worker &worker, Task &task) {
+  if (injected_.load() == 0) {
+    return false;
+  }
+  size_t moved = 0;
+  {
+    std::scoped_lock lock(injection_mtx_);
+    if (injection_.empty()) {
+      return false;
     }
-    try {
-      if (task) {
-        task();
+    task = injection_.pop();
+
+    // Take a fair share so other workers can steal it from our deque rather than queue on the lock.
+    const size_t share = std::min(INJECTION_BATCH, injection_.size() / workers_.size() + 1);
+    for (; moved < share && !injection_.empty(); ++moved) {
+      Slot *slot = acquire_slot(worker);
+      if (!slot) {
+        break;
       }
-    } catch (const std::exception &e) {
-      std::cerr << "Threadpool task threw exception: " << e.what() << std::endl;
-    } catch (...) {
-      std::cerr << "Threadpool task threw unknown exception" << std::endl;
+      slot->task = injection_.pop();
+      worker.deque.push(slot);
     }
+    injected_.fetch_sub(moved + 1);
   }
-}
\ No newline at end of file
+  if (moved > 0) {
+    wake_one();
+  }
+  return true;
+}
+
+bool Threadpool::steal(Worker &thief, Task &task) {
+  thief.rng_state ^= thief.rng_state << 13;
+  thief.rng_state ^= thief.rng_state >> 7;
+  thief.rng_state ^= thief.rng_state << 17;
+  const size_t start = thief.rng_state % workers_.size();
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    Worker &victim = *workers_[(start + i) % workers_.size()];
+    if (&victim == &thief) {
+      continue;
+    }
+    if (const auto slot = victim.deque.steal()) {
+      task = take(**slot);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Threadpool::has_work() const {
+  if (injected_.load() > 0) {
+    return true;
+  }
+  for (const auto &worker : workers_) {
+    if (!worker->deque.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Threadpool::wake_one() {
+  // Pairs with the fence in park(): either the sleeper sees the new work or we see the sleeper.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleepers_.load() > 0) {
+    wake_epoch_.fetch_add(1);
+    wake_epoch_.notify_one();
+  }
+}
+
+void Threadpool::park() {
+  const uint32_t epoch = wake_epoch_.load();
+  sleepers_.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!has_work() && !shutdown_.load()) {
+    wake_epoch_.wait(epoch);
+  }
+  sleepers_.fetch_sub(1);
+}
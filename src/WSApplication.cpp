@@ -1,4 +1,3 @@
-#include <algorithm>
 #include <server/WSApplication.hpp>
 
 WSApplication::WSApplication(Parameters parameters)
@@ -6,7 +5,11 @@ WSApplication::WSApplication(Parameters parameters)
       socket_listener_{parameters_.socket_listener, [this](const int fd) { process_message(fd); }} {}
 
 void WSApplication::activate() {
-  listener_thread_ = std::jthread{[this](const std::stop_token &token) { socket_listener_.run(); }};
+  listener_thread_ = std::jthread{[this] {
+    const int cpu = ThreadPlacement::cpu_for(ThreadPlacement::resolve(parameters_.affinity), 0);
+    ThreadPlacement::apply(cpu, "lws-websocket");
+    socket_listener_.run();
+  }};
 }
 
 void WSApplication::stop() {
@@ -14,19 +17,152 @@ void WSApplication::stop() {
   listener_thread_.request_stop();
 }
 
-void WSApplication::add_connection(WebSocket &connection) {
-  const uint64_t connection_id = connection_counter++;
-  // TODO: normalize counter id to avoid conflicts and overflows
-  auto [it, inserted] = connections.emplace(connection_id, std::move(connection));
-  if (!inserted) {
-    throw std::runtime_error{"Connection with the same ID already exists"};
-  }
-  WebSocket &ws = it->second;
+WSApplication::ConnectionId WSApplication::add_connection(WebSocket &connection) {
+  auto owned = std::make_unique<WebSocket>(std::move(connection));
+  WebSocket &ws = *owned;
   const int connection_fd = ws.get_fd();
-  socket_listener_.add_socket(connection_fd, EPOLLIN);
+  ConnectionId id;
+  {
+    Shard &shard = shard_for(connection_fd);
+    std::scoped_lock lock(shard.mtx);
+    const size_t index = connection_fd / SHARD_COUNT;
+    if (shard.slots.size() <= index) {
+      shard.slots.resize(index + 1);
+    }
+    Slot &slot = shard.slots[index];
+    if (slot.connection) {
+      throw std::runtime_error{"Connection with the same fd already exists"};
+    }
+    slot.connection = std::move(owned);
+    id = static_cast<ConnectionId>(slot.generation) << 32 | static_cast<uint32_t>(connection_fd);
+  }
+
+  // The write interest handler is in place before the open handler runs, so frames it queues are not missed, and
+  // the fd is only armed afterwards. Until then the handler just records the interest for add_socket to pick up;
+  // once armed, the listener may close the connection at any moment, so `ws` is not touched again.
+  const auto registration = std::make_shared<Registration>();
+  ws.on_write_interest([this, connection_fd, registration](const bool interested) {
+    std::scoped_lock lock(registration->mtx);
+    registration->write_interest = interested;
+    if (registration->armed) {
+      socket_listener_.modify_socket(connection_fd, interested ? EPOLLIN | EPOLLOUT : EPOLLIN);
+    }
+  });
   if (open_handler_) {
     open_handler_(ws);
   }
+  std::scoped_lock lock(registration->mtx);
+  // Queued frames are flushed from process_message, which also runs on EPOLLOUT.
+  socket_listener_.add_socket(connection_fd, registration->write_interest ? EPOLLIN | EPOLLOUT : EPOLLIN);
+  registration->armed = true;
+  return id;
+}
+
+std::optional<WSApplication::ConnectionId> WSApplication::connection_id(const WebSocket &connection) const {
+  const int fd = connection.get_fd();
+  const Shard &shard = shard_for(fd);
+  std::scoped_lock lock(shard.mtx);
+  const size_t index = fd / SHARD_COUNT;
+  if (index >= shard.slots.size() || shard.slots[index].connection.get() != &connection) {
+    return std::nullopt;
+  }
+  return static_cast<ConnectionId>(shard.slots[index].generation) << 32 | static_cast<uint32_t>(fd);
+}
+
+std::optional<WebSocket::SendStatus> WSApplication::send(const ConnectionId id, const std::span<const std::byte> payload,
+                                                         const WebSocket::OpCode opcode) {
+  Shard &shard = shard_for(static_cast<int>(id & 0xFFFFFFFF));
+  // Held while sending so the listener cannot close the connection underneath.
+  std::scoped_lock lock(shard.mtx);
+  WebSocket *connection = find_connection_locked(shard, id);
+  if (connection == nullptr) {
+    return std::nullopt;
+  }
+  return connection->send(payload, opcode);
+}
+
+std::optional<WebSocket::SendStatus> WSApplication::send(const ConnectionId id, WebSocket::SharedMessage &message) {
+  Shard &shard = shard_for(static_cast<int>(id & 0xFFFFFFFF));
+  std::scoped_lock lock(shard.mtx);
+  WebSocket *connection = find_connection_locked(shard, id);
+  if (connection == nullptr) {
+    return std::nullopt;
+  }
+  return connection->send(message);
+}
+
+std::optional<WebSocket::SendStatus> WSApplication::send(const ConnectionId id, const std::string &message,
+                                                         const WebSocket::OpCode opcode) {
+  return send(id, std::as_bytes(std::span{message}), opcode);
+}
+
+const WebSocket::Parameters &WSApplication::websocket_parameters() const { return parameters_.websocket; }
+
+void WSApplication::subscribe(WebSocket &connection, const std::string &topic) {
+  const auto id = connection_id(connection);
+  if (!id) {
+    return;
+  }
+  std::scoped_lock lock(topics_mtx_);
+  topics_[topic].insert_or_assign(&connection, *id);
+  subscriptions_[&connection].insert(topic);
+}
+
+void WSApplication::unsubscribe(WebSocket &connection, const std::string &topic) {
+  std::scoped_lock lock(topics_mtx_);
+  if (const auto subscription = subscriptions_.find(&connection); subscription != subscriptions_.end()) {
+    subscription->second.erase(topic);
+    if (subscription->second.empty()) {
+      subscriptions_.erase(subscription);
+    }
+  }
+  if (const auto subscribers = topics_.find(topic); subscribers != topics_.end()) {
+    subscribers->second.erase(&connection);
+    if (subscribers->second.empty()) {
+      topics_.erase(subscribers);
+    }
+  }
+}
+
+size_t WSApplication::publish(const std::string &topic, const std::span<const std::byte> payload,
+                              const WebSocket::OpCode opcode, const WebSocket *exclude) {
+  if (opcode != WebSocket::OpCode::TEXT && opcode != WebSocket::OpCode::BINARY) {
+    throw std::runtime_error("Invalid opcode for message");
+  }
+  // Only the subscriber ids are taken under the lock; sending goes through the shards, so a large topic does not
+  // hold up subscribe, unsubscribe and close on other threads.
+  std::vector<ConnectionId> ids;
+  {
+    std::scoped_lock lock(topics_mtx_);
+    const auto subscribers = topics_.find(topic);
+    if (subscribers == topics_.end()) {
+      return 0;
+    }
+    ids.reserve(subscribers->second.size());
+    for (const auto &[connection, id]: subscribers->second) {
+      if (connection != exclude) {
+        ids.push_back(id);
+      }
+    }
+  }
+  WebSocket::SharedMessage message{.payload = payload, .opcode = opcode, .raw = nullptr, .deflated = {}};
+  size_t delivered = 0;
+  for (const ConnectionId id: ids) {
+    try {
+      const auto status = send(id, message);
+      if (status && *status != WebSocket::SendStatus::DROPPED) {
+        ++delivered;
+      }
+    } catch (const std::exception &) {
+      // The listener notices the broken socket and closes the connection.
+    }
+  }
+  return delivered;
+}
+
+size_t WSApplication::publish(const std::string &topic, const std::string &message, const WebSocket::OpCode opcode,
+                              const WebSocket *exclude) {
+  return publish(topic, std::as_bytes(std::span{message}), opcode, exclude);
 }
 
 void WSApplication::on_open(OpenHandler handler) {
@@ -41,37 +177,86 @@ void WSApplication::on_close(CloseHandler handler) {
   close_handler_ = std::move(handler);
 }
 
-void WSApplication::process_message(int fd) {
-  auto it = std::ranges::find_if(connections, [fd](const auto &pair) { return pair.second.get_fd() == fd; });
-  if (it == connections.end()) {
+WSApplication::Shard &WSApplication::shard_for(const int fd) { return shards_[fd % SHARD_COUNT]; }
+
+const WSApplication::Shard &WSApplication::shard_for(const int fd) const { return shards_[fd % SHARD_COUNT]; }
+
+WebSocket *WSApplication::find_connection_locked(const Shard &shard, const ConnectionId id) {
+  const size_t index = static_cast<int>(id & 0xFFFFFFFF) / SHARD_COUNT;
+  if (index >= shard.slots.size() || shard.slots[index].generation != id >> 32) {
+    return nullptr;
+  }
+  return shard.slots[index].connection.get();
+}
+
+WebSocket *WSApplication::find_connection(const int fd) const {
+  const Shard &shard = shard_for(fd);
+  std::scoped_lock lock(shard.mtx);
+  const size_t index = fd / SHARD_COUNT;
+  return index < shard.slots.size() ? shard.slots[index].connection.get() : nullptr;
+}
+
+void WSApplication::process_message(const int fd) {
+  WebSocket *connection = find_connection(fd);
+  if (connection == nullptr) {
     return;
   }
 
-  WebSocket &ws = it->second;
+  WebSocket &ws = *connection;
   std::string message;
   WebSocket::OpCode op_code;
 
+  // Only the bytes already received are decoded; a partial frame waits for the next EPOLLIN.
   try {
-    ws.read_frame(message, op_code);
-  } catch (const std::exception &ex) {
-    if (close_handler_) {
-      close_handler_(ws);
+    if (!ws.flush()) {
+      close_connection(ws);
+      return;
     }
-    socket_listener_.remove_socket(fd);
-    connections.erase(it);
-    return;
+    const bool open = ws.receive();
+    while (ws.next_message(message, op_code)) {
+      if (op_code == WebSocket::OpCode::CLOSE) {
+        close_connection(ws);
+        return;
+      }
+      if (message_handler_) {
+        message_handler_(ws, message, op_code);
+      }
+    }
+    if (!open) {
+      close_connection(ws);
+    }
+  } catch (const std::exception &ex) {
+    close_connection(ws);
   }
+}
 
-  if (op_code == WebSocket::OpCode::CLOSE) {
-    if (close_handler_) {
-      close_handler_(ws);
+void WSApplication::close_connection(WebSocket &connection) {
+  if (close_handler_) {
+    close_handler_(connection);
+  }
+  {
+    std::scoped_lock lock(topics_mtx_);
+    if (const auto subscription = subscriptions_.find(&connection); subscription != subscriptions_.end()) {
+      for (const std::string &topic: subscription->second) {
+        const auto subscribers = topics_.find(topic);
+        subscribers->second.erase(&connection);
+        if (subscribers->second.empty()) {
+          topics_.erase(subscribers);
+        }
+      }
+      subscriptions_.erase(subscription);
     }
-    socket_listener_.remove_socket(fd);
-    connections.erase(it);
-    return;
   }
+  const int fd = connection.get_fd();
+  socket_listener_.remove_socket(fd);
 
-  if (message_handler_) {
-    message_handler_(ws, message, op_code);
+  // Vacate the slot before the WebSocket closes its fd: the fd may be reused by the next accepted connection.
+  std::unique_ptr<WebSocket> closed;
+  {
+    Shard &shard = shard_for(fd);
+    std::scoped_lock lock(shard.mtx);
+    Slot &slot = shard.slots[fd / SHARD_COUNT];
+    closed = std::move(slot.connection);
+    ++slot.generation;
   }
 }
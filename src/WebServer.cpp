@@ -5,12 +5,31 @@
 #include <ranges>
 #include <server/HttpRequest.hpp>
 #include <server/WebServer.hpp>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <utility>
 
+static std::string serialize_overloaded_response(const int retry_after) {
+    HttpResponse response = HttpResponse::Error(503, "Service Unavailable");
+    response.set_header("Retry-After", std::to_string(retry_after));
+    response.set_header("Connection", "close");
+    return response.to_string();
+}
+
 WebServer::WebServer(Parameters parameters_)
-    : parameters{std::move(parameters_)}, thread_pool_{parameters.num_threads}, ws_app_{std::move(parameters_.ws_app)} {
+    : parameters{std::move(parameters_)},
+      thread_pool_{{.num_threads = parameters.num_threads,
+                    .admission = parameters.admission,
+                    .affinity = parameters.worker_affinity}},
+      event_loop_{parameters.event_loop, &thread_pool_},
+      overloaded_response_{serialize_overloaded_response(parameters.overload_retry_after)},
+      ws_app_{std::move(parameters_.ws_app)},
+      keep_alive_listener_{parameters.keep_alive_listener, [this](const int fd) {
+          if (!thread_pool_.submit([this, fd] { on_http(fd); })) {
+              shed_connection(fd);
+          }
+      }} {
     listen(parameters.port);
 }
 
@@ -18,30 +37,58 @@ void WebServer::get(const std::string &route, RouteHandler handler) {
     handle(HttpRequest::HttpMethod::HTTP_GET, route, std::move(handler));
 }
 
+void WebServer::get(const std::string &route, AsyncRouteHandler handler) {
+    handle(HttpRequest::HttpMethod::HTTP_GET, route, std::move(handler));
+}
+
 void WebServer::post(const std::string &route, RouteHandler handler) {
     handle(HttpRequest::HttpMethod::HTTP_POST, route, std::move(handler));
 }
 
+void WebServer::post(const std::string &route, AsyncRouteHandler handler) {
+    handle(HttpRequest::HttpMethod::HTTP_POST, route, std::move(handler));
+}
+
 void WebServer::put(const std::string &route, RouteHandler handler) {
     handle(HttpRequest::HttpMethod::HTTP_PUT, route, std::move(handler));
 }
 
+void WebServer::put(const std::string &route, AsyncRouteHandler handler) {
+    handle(HttpRequest::HttpMethod::HTTP_PUT, route, std::move(handler));
+}
+
 void WebServer::del(const std::string &route, RouteHandler handler) {
     handle(HttpRequest::HttpMethod::HTTP_DELETE, route, std::move(handler));
 }
 
+void WebServer::del(const std::string &route, AsyncRouteHandler handler) {
+    handle(HttpRequest::HttpMethod::HTTP_DELETE, route, std::move(handler));
+}
+
 void WebServer::patch(const std::string &route, RouteHandler handler) {
     handle(HttpRequest::HttpMethod::HTTP_PATCH, route, std::move(handler));
 }
 
+void WebServer::patch(const std::string &route, AsyncRouteHandler handler) {
+    handle(HttpRequest::HttpMethod::HTTP_PATCH, route, std::move(handler));
+}
+
 void WebServer::head(const std::string &route, RouteHandler handler) {
     handle(HttpRequest::HttpMethod::HTTP_HEAD, route, std::move(handler));
 }
 
+void WebServer::head(const std::string &route, AsyncRouteHandler handler) {
+    handle(HttpRequest::HttpMethod::HTTP_HEAD, route, std::move(handler));
+}
+
 void WebServer::options(const std::string &route, RouteHandler handler) {
     handle(HttpRequest::HttpMethod::HTTP_OPTIONS, route, std::move(handler));
 }
 
+void WebServer::options(const std::string &route, AsyncRouteHandler handler) {
+    handle(HttpRequest::HttpMethod::HTTP_OPTIONS, route, std::move(handler));
+}
+
 WebServer &WebServer::on_open(WSApplication::OpenHandler handler) {
     ws_app_.on_open(std::move(handler));
     return *this;
@@ -60,8 +107,31 @@ WebServer &WebServer::on_close(WSApplication::CloseHandler handler) {
 void WebServer::activate_websockets() { ws_app_.activate(); }
 
 void WebServer::run() {
-    server_thread = std::jthread{[this](const std::stop_token &st) { main_thread_acceptor(st); }};
+    const std::vector<int> cpus = ThreadPlacement::resolve(parameters.event_loop_affinity);
+    event_loop_thread_ = std::jthread{
+        [this, cpu = ThreadPlacement::cpu_for(cpus, reactors_.empty() ? 2 : reactors_.size())](const std::stop_token &) {
+            ThreadPlacement::apply(cpu, "lws-io");
+            event_loop_.run();
+        }};
+    if (!reactors_.empty()) {
+        for (size_t i = 0; i < reactors_.size(); ++i) {
+            const int cpu = ThreadPlacement::cpu_for(cpus, i);
+            reactors_[i]->thread = std::jthread{[&listener = *reactors_[i]->listener, cpu, i](const std::stop_token &) {
+                ThreadPlacement::apply(cpu, "lws-reactor-" + std::to_string(i));
+                listener.run();
+            }};
+        }
+        return;
+    }
+    server_thread = std::jthread{[this, cpu = ThreadPlacement::cpu_for(cpus, 0)](const std::stop_token &st) {
+        ThreadPlacement::apply(cpu, "lws-acceptor");
+        main_thread_acceptor(st);
+    }};
     stop_source = server_thread.get_stop_source();
+    keep_alive_thread_ = std::jthread{[this, cpu = ThreadPlacement::cpu_for(cpus, 1)](const std::stop_token &) {
+        ThreadPlacement::apply(cpu, "lws-keepalive");
+        keep_alive_listener_.run();
+    }};
 }
 
 void WebServer::request_stop() {
@@ -75,13 +145,53 @@ void WebServer::request_stop() {
 
     thread_pool_.request_stop();
 
+    event_loop_.stop();
+
     ws_app_.stop();
 
-    shutdown(server_fd, SHUT_RDWR);
+    keep_alive_listener_.stop();
+
+    for (const auto &reactor: reactors_) {
+        reactor->listener->stop();
+    }
+
+    if (server_fd >= 0) {
+        shutdown(server_fd, SHUT_RDWR);
+    }
 
     wait_for_exit();
 
-    close(server_fd);
+    // Coroutines still suspended at this point are abandoned; the loop must not resume them into closed connections.
+    if (event_loop_thread_.joinable()) {
+        event_loop_thread_.join();
+    }
+
+    if (keep_alive_thread_.joinable()) {
+        keep_alive_thread_.join();
+    }
+    {
+        std::scoped_lock lock(keep_alive_mtx_);
+        for (const auto &client_fd: keep_alive_connections_ | std::views::keys) {
+            close(client_fd);
+        }
+        keep_alive_connections_.clear();
+    }
+
+    for (const auto &reactor: reactors_) {
+        if (reactor->thread.joinable()) {
+            reactor->thread.join();
+        }
+        for (const auto &client_fd: reactor->connections | std::views::keys) {
+            close(client_fd);
+        }
+        reactor->connections.clear();
+        close(reactor->listen_fd);
+        close(reactor->wake_fd);
+    }
+
+    if (server_fd >= 0) {
+        close(server_fd);
+    }
 }
 
 void WebServer::wait_for_exit() {
@@ -91,87 +201,267 @@ void WebServer::wait_for_exit() {
 }
 
 void WebServer::on_http(int client_fd) {
-    char buffer[1024];
-    ssize_t bytes_read = read(client_fd, buffer, sizeof(buffer) - 1);
+    HttpRequest req;
+    settle(nullptr, client_fd, serve_request(get_connection(client_fd), req, nullptr), req);
+}
 
-    if (bytes_read > 0) {
-        buffer[bytes_read] = '\0';
+int WebServer::get_port() const {
+    return ntohs(address.sin_port);
+}
 
-        std::string request_raw(buffer);
-        HttpRequest req = HttpRequest::parse_http_request(request_raw);
+EventLoop &WebServer::event_loop() {
+    return event_loop_;
+}
+
+WSApplication &WebServer::websockets() {
+    return ws_app_;
+}
+
+WebServer::ConnectionState WebServer::serve_request(HttpConnection &connection, HttpRequest &req, Reactor *reactor) {
+    if (connection.has_pending_output()) {
+        switch (connection.flush()) {
+            case HttpConnection::SendStatus::COMPLETE:
+                break;
+            case HttpConnection::SendStatus::PENDING:
+                return ConnectionState::WRITING;
+            case HttpConnection::SendStatus::FAILED:
+                return ConnectionState::CLOSE;
+        }
+        if (connection.close_after_send) {
+            return ConnectionState::CLOSE;
+        }
+    }
+
+    do {
+        HttpResponse response;
+        switch (connection.read_request(parameters.http_connection)) {
+            case HttpConnection::ReadStatus::COMPLETE:
+                break;
+            case HttpConnection::ReadStatus::INCOMPLETE:
+                return ConnectionState::KEEP_ALIVE;
+            case HttpConnection::ReadStatus::CLOSED:
+                return ConnectionState::CLOSE;
+            case HttpConnection::ReadStatus::BAD_REQUEST:
+                response = HttpResponse::Error(400, "Bad Request");
+                break;
+            case HttpConnection::ReadStatus::HEADERS_TOO_LARGE:
+                response = HttpResponse::Error(431, "Request Header Fields Too Large");
+                break;
+            case HttpConnection::ReadStatus::BODY_TOO_LARGE:
+                response = HttpResponse::Error(413, "Payload Too Large");
+                break;
+        }
+        if (response.status_code != 200) {
+            response.set_header("Connection", "close");
+            return write_response(connection, response, false);
+        }
+
+        req = HttpRequest::parse_http_request(connection.take_request());
         if (req.method == HttpRequest::HttpMethod::HTTP_UNKNOWN) {
-            HttpResponse response = HttpResponse::NotFound("Unknown HTTP method");
-            write(client_fd, response.to_string().c_str(), response.to_string().size());
-            close(client_fd);
-            return;
+            response = HttpResponse::NotFound("Unknown HTTP method");
+            response.set_header("Connection", "close");
+            return write_response(connection, response, false);
         }
 
         if (req.is_websocket_upgrade()) {
-            WebSocket ws{client_fd};
-            ws_app_.add_connection(ws);
-            HttpResponse ws_response =
-                    HttpResponse::WebSocketSwitchingProtocols(ws.accept_handshake(req.get_websocket_key()));
-            std::string resp_str = ws_response.to_string();
-            write(client_fd, resp_str.c_str(), resp_str.size());
-            return;
+            return ConnectionState::UPGRADE;
         }
 
-        HttpResponse response;
-        const auto &handlers = method_handlers[req.method];
-        auto exact_match = handlers.find(req.path);
-        if (exact_match != handlers.end()) {
-            response = exact_match->second(req);
+        const Router::Route *route = router_.match(req);
+        if (route && route->async_handler) {
+            serve_async(route->async_handler, connection, std::move(req), reactor);
+            return ConnectionState::PENDING;
+        }
+        if (route) {
+            response = route->handler(req);
         } else {
-            bool matched = false;
-            for (const auto &[route_prefix, handler]: handlers) {
-                if (!route_prefix.empty() && req.path.starts_with(route_prefix)) {
-                    response = handler(req);
-                    matched = true;
-                    break;
-                }
-            }
-            if (!matched) {
-                response = HttpResponse::NotFound("404 Not Found: " + req.path);
-            }
+            response = HttpResponse::NotFound("404 Not Found: " + std::string{req.path});
+        }
+
+        if (const ConnectionState state = respond(connection, req, response); state != ConnectionState::KEEP_ALIVE) {
+            return state;
+        }
+    } while (connection.has_buffered_data());
+
+    return ConnectionState::KEEP_ALIVE;
+}
+
+DetachedTask WebServer::serve_async(const AsyncRouteHandler &handler, HttpConnection &connection, HttpRequest req,
+                                    Reactor *reactor) {
+    const int client_fd = connection.get_fd();
+    HttpResponse response;
+    try {
+        response = co_await handler(req);
+    } catch (const std::exception &e) {
+        std::cerr << "Async route handler threw exception: " << e.what() << std::endl;
+        response = HttpResponse::Error(500, "Internal Server Error");
+    } catch (...) {
+        std::cerr << "Async route handler threw unknown exception" << std::endl;
+        response = HttpResponse::Error(500, "Internal Server Error");
+    }
+
+    // Pipelined requests behind this one are served by whichever thread resumed the coroutine.
+    ConnectionState state = ConnectionState::CLOSE;
+    try {
+        state = respond(connection, req, response);
+        if (state == ConnectionState::KEEP_ALIVE && connection.has_buffered_data()) {
+            state = serve_request(connection, req, reactor);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Serving pipelined request threw exception: " << e.what() << std::endl;
+        state = ConnectionState::CLOSE;
+    } catch (...) {
+        std::cerr << "Serving pipelined request threw unknown exception" << std::endl;
+        state = ConnectionState::CLOSE;
+    }
+    // Nothing may escape: DetachedTask terminates the process on an unhandled exception.
+    try {
+        settle(reactor, client_fd, state, req);
+    } catch (...) {
+        std::cerr << "Settling async connection failed, closing it" << std::endl;
+        if (reactor != nullptr) {
+            // The loop drops the stale HttpConnection when the fd is accepted again.
+            close(client_fd);
+        } else {
+            close_connection(client_fd);
         }
+    }
+}
 
-        std::string resp_str = response.to_string();
-        write(client_fd, resp_str.c_str(), resp_str.size());
-        close(client_fd);
+WebServer::ConnectionState WebServer::respond(HttpConnection &connection, const HttpRequest &req,
+                                              HttpResponse &response) {
+    if (parameters.compression.enabled) {
+        HttpCompression::compress(response, req, parameters.compression);
     }
+
+    const bool persistent = req.keep_alive() && ++connection.requests_served < parameters.max_keep_alive_requests;
+    response.set_header("Connection", persistent ? "keep-alive" : "close");
+    return write_response(connection, response, persistent);
 }
 
-void WebServer::listen(const int port) {
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) {
+WebServer::ConnectionState WebServer::write_response(HttpConnection &connection, HttpResponse &response,
+                                                     const bool persistent) {
+    connection.close_after_send = !persistent;
+    switch (connection.send_response(std::move(response))) {
+        case HttpConnection::SendStatus::COMPLETE:
+            return persistent ? ConnectionState::KEEP_ALIVE : ConnectionState::CLOSE;
+        case HttpConnection::SendStatus::PENDING:
+            return ConnectionState::WRITING;
+        case HttpConnection::SendStatus::FAILED:
+            break;
+    }
+    return ConnectionState::CLOSE;
+}
+
+void WebServer::settle(Reactor *reactor, const int client_fd, const ConnectionState state, HttpRequest &req) {
+    if (state == ConnectionState::PENDING) {
+        return;
+    }
+    if (reactor != nullptr) {
+        {
+            std::scoped_lock lock(reactor->completed_mtx);
+            reactor->completed.push_back({client_fd, state, std::move(req)});
+        }
+        eventfd_write(reactor->wake_fd, 1);
+        return;
+    }
+    switch (state) {
+        case ConnectionState::KEEP_ALIVE:
+            keep_alive(client_fd);
+            break;
+        case ConnectionState::WRITING:
+            keep_alive(client_fd, EPOLLOUT);
+            break;
+        case ConnectionState::CLOSE:
+            close_connection(client_fd);
+            break;
+        case ConnectionState::UPGRADE:
+            release_connection(client_fd);
+            upgrade_to_websocket(client_fd, req);
+            break;
+        case ConnectionState::PENDING:
+            break;
+    }
+}
+
+void WebServer::upgrade_to_websocket(int client_fd, const HttpRequest &req) {
+    WebSocket ws{client_fd, ws_app_.websocket_parameters()};
+    const auto offers = req.headers.find(HttpHeader::SEC_WEBSOCKET_EXTENSIONS);
+    const std::string extensions = offers != req.headers.end() ? ws.negotiate_extensions(offers->second) : "";
+    HttpResponse ws_response =
+        HttpResponse::WebSocketSwitchingProtocols(ws.accept_handshake(req.get_websocket_key()), extensions);
+    // The 101 goes out before the socket is registered, so frames sent from the open handler cannot overtake it.
+    // It fits any fresh socket buffer; a peer that does not take it is dropped.
+    if (HttpConnection{client_fd}.send_response(std::move(ws_response)) != HttpConnection::SendStatus::COMPLETE) {
+        return;
+    }
+    ws_app_.add_connection(ws);
+}
+
+int WebServer::open_listen_socket(const int port, const bool reuse_port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
         throw std::runtime_error("socket creation failed");
     }
 
     const int opt = 1;
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        close(server_fd);
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        close(fd);
         throw std::runtime_error("setsockopt failed");
     }
+    if (reuse_port && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        close(fd);
+        throw std::runtime_error("setsockopt SO_REUSEPORT failed");
+    }
 
     std::memset(&address, 0, sizeof(address));
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
     address.sin_port = htons(port);
 
-    if (bind(server_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
-        close(server_fd);
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        close(fd);
         throw std::runtime_error("bind failed");
     }
-    if (::listen(server_fd, 3) < 0) {
-        close(server_fd);
+    if (::listen(fd, SOMAXCONN) < 0) {
+        close(fd);
         throw std::runtime_error("listen failed");
     }
+
+    socklen_t addr_len = sizeof(address);
+    getsockname(fd, reinterpret_cast<sockaddr *>(&address), &addr_len);
+    return fd;
+}
+
+void WebServer::listen(const int port) {
+    if (parameters.reactors == 0) {
+        server_fd = open_listen_socket(port, false);
+        return;
+    }
+
+    for (size_t i = 0; i < parameters.reactors; ++i) {
+        // The first bind resolves port 0, the remaining sockets join the same SO_REUSEPORT group.
+        const int listen_fd = open_listen_socket(i == 0 ? port : get_port(), true);
+        auto reactor = std::make_unique<Reactor>();
+        reactor->listen_fd = listen_fd;
+        reactor->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (reactor->wake_fd < 0) {
+            close(listen_fd);
+            throw std::runtime_error("eventfd creation failed");
+        }
+        reactor->listener = std::make_unique<SocketListener>(
+            parameters.reactor_listener, [this, &r = *reactor](const int fd) { on_reactor_event(r, fd); });
+        reactor->listener->add_socket(listen_fd, EPOLLIN);
+        reactor->listener->add_socket(reactor->wake_fd, EPOLLIN);
+        reactors_.push_back(std::move(reactor));
+    }
 }
 
 void WebServer::main_thread_acceptor(const std::stop_token &token) {
     while (!token.stop_requested()) {
-        socklen_t addr_len = sizeof(address);
-        int client_fd = accept(server_fd, reinterpret_cast<sockaddr *>(&address), &addr_len);
+        sockaddr_in client_address{};
+        socklen_t addr_len = sizeof(client_address);
+        int client_fd = accept4(server_fd, reinterpret_cast<sockaddr *>(&client_address), &addr_len, SOCK_NONBLOCK);
         if (client_fd < 0) {
             continue;
         } {
@@ -181,10 +471,125 @@ void WebServer::main_thread_acceptor(const std::stop_token &token) {
                 break;
             }
         }
-        thread_pool_.submit([this, client_fd]() { on_http(client_fd); });
+        if (!thread_pool_.submit([this, client_fd]() { on_http(client_fd); })) {
+            shed_connection(client_fd);
+        }
+    }
+}
+
+void WebServer::on_reactor_event(Reactor &reactor, const int fd) {
+    if (fd == reactor.listen_fd) {
+        while (true) {
+            const int client_fd = accept4(reactor.listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+            if (client_fd < 0) {
+                return;
+            }
+            reactor.connections.insert_or_assign(client_fd, HttpConnection{client_fd});
+            reactor.listener->add_socket(client_fd, EPOLLIN);
+        }
+    }
+
+    if (fd == reactor.wake_fd) {
+        on_reactor_wake(reactor);
+        return;
+    }
+
+    const auto it = reactor.connections.find(fd);
+    if (it == reactor.connections.end()) {
+        return;
+    }
+
+    HttpRequest req;
+    const bool was_writing = it->second.has_pending_output();
+    const ConnectionState state = serve_request(it->second, req, &reactor);
+    if (state == ConnectionState::KEEP_ALIVE || state == ConnectionState::WRITING) {
+        if (was_writing != (state == ConnectionState::WRITING)) {
+            reactor.listener->modify_socket(fd, state == ConnectionState::WRITING ? EPOLLOUT : EPOLLIN);
+        }
+        return;
+    }
+    reactor.listener->remove_socket(fd);
+    if (state == ConnectionState::PENDING) {
+        return;
+    }
+    reactor.connections.erase(it);
+    if (state == ConnectionState::UPGRADE) {
+        upgrade_to_websocket(fd, req);
+    } else {
+        close(fd);
+    }
+}
+
+void WebServer::on_reactor_wake(Reactor &reactor) {
+    eventfd_t count;
+    eventfd_read(reactor.wake_fd, &count);
+    std::vector<Completion> completed;
+    {
+        std::scoped_lock lock(reactor.completed_mtx);
+        completed.swap(reactor.completed);
+    }
+    for (auto &[fd, state, req]: completed) {
+        if (state == ConnectionState::KEEP_ALIVE || state == ConnectionState::WRITING) {
+            reactor.listener->add_socket(fd, state == ConnectionState::WRITING ? EPOLLOUT : EPOLLIN);
+            continue;
+        }
+        reactor.connections.erase(fd);
+        if (state == ConnectionState::UPGRADE) {
+            upgrade_to_websocket(fd, req);
+        } else {
+            close(fd);
+        }
     }
 }
 
 void WebServer::handle(const HttpRequest::HttpMethod method, const std::string &route, RouteHandler handler) {
-    method_handlers[method][route] = std::move(handler);
+    router_.add(method, route, std::move(handler));
+}
+
+void WebServer::handle(const HttpRequest::HttpMethod method, const std::string &route, AsyncRouteHandler handler) {
+    router_.add(method, route, std::move(handler));
+}
+
+HttpConnection &WebServer::get_connection(const int client_fd) {
+    std::scoped_lock lock(keep_alive_mtx_);
+    return keep_alive_connections_.try_emplace(client_fd, client_fd).first->second;
+}
+
+void WebServer::keep_alive(const int client_fd, const uint32_t events) {
+    bool registered;
+    {
+        std::scoped_lock lock(keep_alive_mtx_);
+        registered = std::exchange(keep_alive_connections_.try_emplace(client_fd, client_fd).first->second.registered, true);
+    }
+    // One-shot keeps a connection owned by a single worker until it re-arms it here.
+    if (registered) {
+        keep_alive_listener_.modify_socket(client_fd, events | EPOLLONESHOT);
+    } else {
+        keep_alive_listener_.add_socket(client_fd, events | EPOLLONESHOT);
+    }
+}
+
+void WebServer::release_connection(const int client_fd) {
+    bool registered = false;
+    {
+        std::scoped_lock lock(keep_alive_mtx_);
+        if (const auto it = keep_alive_connections_.find(client_fd); it != keep_alive_connections_.end()) {
+            registered = it->second.registered;
+            keep_alive_connections_.erase(it);
+        }
+    }
+    if (registered) {
+        keep_alive_listener_.remove_socket(client_fd);
+    }
+}
+
+void WebServer::close_connection(const int client_fd) {
+    release_connection(client_fd);
+    close(client_fd);
+}
+
+void WebServer::shed_connection(const int client_fd) {
+    // Best effort: an overloaded server must not wait on a slow client.
+    send(client_fd, overloaded_response_.data(), overloaded_response_.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    close_connection(client_fd);
 }
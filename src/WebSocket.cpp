@@ -1,13 +1,27 @@
+#include <cstring>
+#include <limits>
 #include <netinet/in.h>
 #include <server/WebSocket.hpp>
+#include <server/WebSocketPayload.hpp>
 #include <sha1.hpp>
 #include <sys/socket.h>
 
-WebSocket::WebSocket(const int socket_fd) : socket_fd_{socket_fd}, state_{State::CONNECTING} {}
+WebSocket::WebSocket(const int socket_fd) : WebSocket{socket_fd, Parameters{}} {}
+
+WebSocket::WebSocket(const int socket_fd, const Parameters parameters)
+    : socket_fd_{socket_fd}, state_{State::CONNECTING}, parameters_{parameters} {}
 
 WebSocket::WebSocket(WebSocket &&other) noexcept
-    : socket_fd_{std::exchange(other.socket_fd_, -1)}, state_{other.state_},
-      message_handler_{std::move(other.message_handler_)} {
+    : receive_buffer_{std::move(other.receive_buffer_)}, receive_begin_{std::exchange(other.receive_begin_, 0)},
+      receive_end_{std::exchange(other.receive_end_, 0)}, frame_{std::exchange(other.frame_, {})},
+      message_opcode_{std::exchange(other.message_opcode_, 0)}, message_buffer_{std::move(other.message_buffer_)},
+      control_payload_{std::move(other.control_payload_)}, socket_fd_{std::exchange(other.socket_fd_, -1)},
+      state_{other.state_}, message_handler_{std::move(other.message_handler_)}, parameters_{other.parameters_},
+      outbound_{std::move(other.outbound_)}, outbound_offset_{std::exchange(other.outbound_offset_, 0)},
+      outbound_size_{std::exchange(other.outbound_size_, 0)},
+      write_interest_{std::exchange(other.write_interest_, false)},
+      write_interest_handler_{std::move(other.write_interest_handler_)}, deflate_{std::move(other.deflate_)},
+      message_compressed_{std::exchange(other.message_compressed_, false)} {
   other.state_ = State::CLOSED;
   other.message_handler_ = nullptr;
 }
@@ -17,9 +31,24 @@ WebSocket &WebSocket::operator=(WebSocket &&other) noexcept {
     if (socket_fd_ != -1) {
       close(socket_fd_);
     }
+    receive_buffer_ = std::move(other.receive_buffer_);
+    receive_begin_ = std::exchange(other.receive_begin_, 0);
+    receive_end_ = std::exchange(other.receive_end_, 0);
+    frame_ = std::exchange(other.frame_, {});
+    message_opcode_ = std::exchange(other.message_opcode_, 0);
+    message_buffer_ = std::move(other.message_buffer_);
+    control_payload_ = std::move(other.control_payload_);
     socket_fd_ = std::exchange(other.socket_fd_, -1);
     state_ = other.state_;
     message_handler_ = std::move(other.message_handler_);
+    parameters_ = other.parameters_;
+    outbound_ = std::move(other.outbound_);
+    outbound_offset_ = std::exchange(other.outbound_offset_, 0);
+    outbound_size_ = std::exchange(other.outbound_size_, 0);
+    write_interest_ = std::exchange(other.write_interest_, false);
+    write_interest_handler_ = std::move(other.write_interest_handler_);
+    deflate_ = std::move(other.deflate_);
+    message_compressed_ = std::exchange(other.message_compressed_, false);
     other.state_ = State::CLOSED;
     other.message_handler_ = nullptr;
   }
@@ -30,30 +59,203 @@ WebSocket::~WebSocket() { close(socket_fd_); }
 
 int WebSocket::get_fd() const { return socket_fd_; }
 
-void WebSocket::send(const std::string &message, const OpCode opcode) const {
+WebSocket::SendStatus WebSocket::send(const std::string &message, const OpCode opcode) {
+  return send(std::as_bytes(std::span{message}), opcode);
+}
+
+WebSocket::SendStatus WebSocket::send(const std::span<const std::byte> payload, const OpCode opcode) {
   if (opcode != OpCode::TEXT && opcode != OpCode::BINARY) {
     throw std::runtime_error("Invalid opcode for message");
   }
-  if (opcode == OpCode::TEXT) {
-    send_frame(std::vector<uint8_t>{message.begin(), message.end()}, opcode);
-  } else {
-    const size_t message_length = message.size();
-    const size_t frames_count = (message_length + MAX_BINARY_FRAME_SIZE - 1) / MAX_BINARY_FRAME_SIZE;
-    for (size_t i = 0; i < frames_count; ++i) {
-      const size_t start = i * MAX_BINARY_FRAME_SIZE;
-      const size_t end = std::min(start + MAX_BINARY_FRAME_SIZE, message_length);
-      send_frame(std::vector<uint8_t>{message.begin() + start, message.begin() + end}, opcode, i == frames_count - 1);
+  return send_frames(payload, opcode);
+}
+
+WebSocket::EncodedMessage WebSocket::encode(const std::span<const std::byte> payload, const OpCode opcode) {
+  if (opcode != OpCode::TEXT && opcode != OpCode::BINARY) {
+    throw std::runtime_error("Invalid opcode for message");
+  }
+  std::string frames;
+  append_frames(frames, payload, opcode, frame_size_limit(opcode), false);
+  return std::make_shared<const std::string>(std::move(frames));
+}
+
+WebSocket::SendStatus WebSocket::send(SharedMessage &message) {
+  const std::span<const std::byte> payload = message.payload;
+  if (deflate_ && payload.size() >= deflate_->parameters().min_size) {
+    const WebSocketDeflate::Agreement &agreement = deflate_->agreement();
+    if (!agreement.server_no_context_takeover) {
+      // Compressed against this connection's history, so nobody else can use the frame.
+      return send(payload, message.opcode);
+    }
+    EncodedMessage &deflated = message.deflated[agreement.server_max_window_bits];
+    if (!deflated) {
+      const std::string compressed = WebSocketDeflate::compress_once(
+          {reinterpret_cast<const char *>(payload.data()), payload.size()}, agreement.server_max_window_bits,
+          deflate_->parameters().level, agreement.mem_level);
+      std::string frames;
+      append_frames(frames, std::as_bytes(std::span{compressed}), message.opcode, frame_size_limit(message.opcode),
+                    true);
+      deflated = std::make_shared<const std::string>(std::move(frames));
+    }
+    return send(deflated);
+  }
+  if (!message.raw) {
+    message.raw = encode(payload, message.opcode);
+  }
+  return send(message.raw);
+}
+
+std::string WebSocket::negotiate_extensions(const std::string_view offers) {
+  const auto agreement = WebSocketDeflate::negotiate(offers, parameters_.deflate);
+  if (!agreement) {
+    return {};
+  }
+  deflate_ = std::make_unique<WebSocketDeflate>(*agreement, parameters_.deflate);
+  return WebSocketDeflate::response_header(*agreement);
+}
+
+WebSocket::SendStatus WebSocket::send(const EncodedMessage &message) {
+  std::scoped_lock lock(send_mtx_);
+  if (!outbound_.empty()) {
+    return enqueue(message);
+  }
+  iovec iov{const_cast<char *>(message->data()), message->size()};
+  iovec *pending = &iov;
+  int iov_count = 1;
+  if (write_some(pending, iov_count)) {
+    return SendStatus::SENT;
+  }
+  outbound_offset_ = message->size() - iov.iov_len;
+  outbound_size_ = iov.iov_len;
+  outbound_.push_back(message);
+  set_write_interest(true);
+  return SendStatus::QUEUED;
+}
+
+bool WebSocket::flush() {
+  std::scoped_lock lock(send_mtx_);
+  while (!outbound_.empty()) {
+    iovec iov[FRAMES_PER_WRITE * 2];
+    int iov_count = 0;
+    for (auto it = outbound_.begin(); it != outbound_.end() && iov_count < static_cast<int>(std::size(iov)); ++it) {
+      const size_t skip = iov_count == 0 ? outbound_offset_ : 0;
+      iov[iov_count++] = {const_cast<char *>((*it)->data()) + skip, (*it)->size() - skip};
     }
+    msghdr message{};
+    message.msg_iov = iov;
+    message.msg_iovlen = iov_count;
+    const ssize_t n = sendmsg(socket_fd_, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+    auto written = static_cast<size_t>(n);
+    outbound_size_ -= written;
+    while (written > 0 && written >= outbound_.front()->size() - outbound_offset_) {
+      written -= outbound_.front()->size() - outbound_offset_;
+      outbound_.pop_front();
+      outbound_offset_ = 0;
+    }
+    outbound_offset_ += written;
+  }
+  set_write_interest(false);
+  return true;
+}
+
+size_t WebSocket::buffered_amount() const {
+  std::scoped_lock lock(send_mtx_);
+  return outbound_size_;
+}
+
+void WebSocket::on_write_interest(WriteInterestHandler handler) {
+  std::scoped_lock lock(send_mtx_);
+  write_interest_handler_ = std::move(handler);
+  if (write_interest_ && write_interest_handler_) {
+    write_interest_handler_(true);
   }
 }
 
-void WebSocket::read_frame(std::string &message, OpCode &opcode) const {
-  std::vector<uint8_t> raw_message;
-  uint8_t op_code;
-  get_websocket_frame(raw_message, op_code);
-  // TODO: make std::variant<string_view, std::vector<uint8_t>> for messages like images
-  message = std::string(reinterpret_cast<const char *>(raw_message.data()), raw_message.size());
-  opcode = to_opcode(op_code);
+bool WebSocket::receive() {
+  size_t total = 0;
+  while (total < MAX_RECEIVE_SIZE) {
+    if (receive_buffer_.size() - receive_end_ < RECEIVE_CHUNK_SIZE) {
+      // Payload bytes are consumed as they arrive, so at most a partial frame header is moved to the front.
+      if (receive_begin_ > 0) {
+        std::memmove(receive_buffer_.data(), receive_buffer_.data() + receive_begin_, receive_end_ - receive_begin_);
+        receive_end_ -= receive_begin_;
+        receive_begin_ = 0;
+      }
+      if (receive_buffer_.size() - receive_end_ < RECEIVE_CHUNK_SIZE) {
+        receive_buffer_.resize(receive_end_ + RECEIVE_CHUNK_SIZE);
+      }
+    }
+    const ssize_t n = recv(socket_fd_, receive_buffer_.data() + receive_end_, receive_buffer_.size() - receive_end_, 0);
+    if (n > 0) {
+      receive_end_ += n;
+      total += n;
+    } else if (n == 0) {
+      return false;
+    } else if (errno != EINTR) {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+  }
+  return true;
+}
+
+bool WebSocket::next_message(std::string &message, OpCode &opcode) {
+  while (true) {
+    if (frame_.stage == DecodeStage::HEADER && !decode_header()) {
+      return false;
+    }
+
+    const size_t take = std::min<uint64_t>(frame_.remaining, receive_end_ - receive_begin_);
+    std::string &target = (frame_.opcode & 0x8) != 0 ? control_payload_ : message_buffer_;
+    const size_t at = target.size();
+    target.append(reinterpret_cast<const char *>(receive_buffer_.data() + receive_begin_), take);
+    if (frame_.masked) {
+      WebSocketPayload::unmask(target.data() + at, take, frame_.masking_key, frame_.received);
+    }
+    receive_begin_ += take;
+    frame_.received += take;
+    frame_.remaining -= take;
+    if (frame_.remaining > 0) {
+      return false;
+    }
+    frame_.stage = DecodeStage::HEADER;
+
+    switch (frame_.opcode) {
+    case 0x8:
+      opcode = OpCode::CLOSE;
+      message = std::move(control_payload_);
+      control_payload_.clear();
+      return true;
+    case 0x9:
+      send_frames(std::as_bytes(std::span{control_payload_}), OpCode::PONG);
+      control_payload_.clear();
+      break;
+    case 0xA:
+      control_payload_.clear();
+      break;
+    default:
+      if (frame_.fin) {
+        if (message_compressed_) {
+          message_buffer_ = deflate_->decompress(message_buffer_, MAX_MESSAGE_SIZE);
+          message_compressed_ = false;
+        }
+        if (message_opcode_ == 0x1 && !WebSocketPayload::is_valid_utf8(message_buffer_)) {
+          throw std::runtime_error("WebSocket text message is not valid UTF-8");
+        }
+        opcode = to_opcode(message_opcode_);
+        message = std::move(message_buffer_);
+        message_buffer_.clear();
+        message_opcode_ = 0;
+        return true;
+      }
+    }
+  }
 }
 
 std::string WebSocket::accept_handshake(const std::string &websocket_key) {
@@ -67,141 +269,230 @@ std::string WebSocket::accept_handshake(const std::string &websocket_key) {
 
 void WebSocket::on_message(MessageHandler handler) { message_handler_ = std::move(handler); }
 
-void WebSocket::get_websocket_frame(std::vector<uint8_t> &raw_message, uint8_t &op_code) const {
-  bool is_final_frame = false;
-  bool is_first_frame = true;
-
-  do {
-    bool fin = false;
-    uint8_t opcode = 0;
-    std::vector<uint8_t> payload = parse_frame(fin, opcode);
+WebSocket::SendStatus WebSocket::send_frames(const std::span<const std::byte> message, const OpCode opcode) {
+  std::scoped_lock lock(send_mtx_);
+  // Compressed under the lock: with context takeover, messages have to enter the deflate stream in wire order.
+  std::span<const std::byte> payload = message;
+  std::string deflated;
+  const bool compressed = deflate_ && opcode != OpCode::PONG && message.size() >= deflate_->parameters().min_size;
+  if (compressed) {
+    deflate_->compress({reinterpret_cast<const char *>(message.data()), message.size()}, deflated);
+    payload = std::as_bytes(std::span{deflated});
+  }
+  const size_t max_frame_size = frame_size_limit(opcode);
+  if (!outbound_.empty()) {
+    std::string frames;
+    append_frames(frames, payload, opcode, max_frame_size, compressed);
+    return enqueue(std::make_shared<const std::string>(std::move(frames)));
+  }
 
-    if (is_first_frame) {
-      if (opcode != 0x1 && opcode != 0x2) {
-        throw std::runtime_error("Unexpected opcode for initial frame");
+  uint8_t headers[FRAMES_PER_WRITE][MAX_HEADER_SIZE];
+  iovec iov[FRAMES_PER_WRITE * 2];
+  size_t offset = 0;
+  bool first = true;
+  while (first || offset < payload.size()) {
+    int iov_count = 0;
+    for (size_t frame = 0; frame < FRAMES_PER_WRITE && (first || offset < payload.size()); ++frame) {
+      const size_t length = std::min(max_frame_size, payload.size() - offset);
+      const size_t header_size = encode_header(headers[frame], first ? opcode : OpCode::CONTINUATION,
+                                               offset + length == payload.size(), length, first && compressed);
+      iov[iov_count++] = {headers[frame], header_size};
+      if (length > 0) {
+        iov[iov_count++] = {const_cast<std::byte *>(payload.data() + offset), length};
       }
-      op_code = opcode;
-      is_first_frame = false;
-    } else {
-      if (opcode != 0x0) {
-        throw std::runtime_error("Expected continuation frame");
+      offset += length;
+      first = false;
+    }
+    iovec *pending = iov;
+    if (!write_some(pending, iov_count)) {
+      // The socket is full: the unwritten part of this batch and the frames after it wait for EPOLLOUT. They are
+      // queued whatever the policy, since part of the message may be on the wire already.
+      std::string rest;
+      for (int i = 0; i < iov_count; ++i) {
+        rest.append(static_cast<const char *>(pending[i].iov_base), pending[i].iov_len);
+      }
+      if (offset < payload.size()) {
+        append_frames(rest, payload.subspan(offset), OpCode::CONTINUATION, max_frame_size, false);
       }
+      outbound_size_ = rest.size();
+      outbound_.push_back(std::make_shared<const std::string>(std::move(rest)));
+      set_write_interest(true);
+      return SendStatus::QUEUED;
     }
-    raw_message.insert(raw_message.end(), payload.begin(), payload.end());
-    is_final_frame = fin;
-  } while (!is_final_frame);
+  }
+  return SendStatus::SENT;
 }
 
-void WebSocket::send_frame(const std::vector<uint8_t> &data, const OpCode opcode, bool is_final) const {
-  std::vector<uint8_t> header;
-
-  uint8_t byte1 = 0;
-  if (is_final) {
-    byte1 |= 0x80; // Set FIN bit
+void WebSocket::append_frames(std::string &out, const std::span<const std::byte> payload, const OpCode opcode,
+                              const size_t max_frame_size, const bool compressed) {
+  size_t offset = 0;
+  bool first = true;
+  while (first || offset < payload.size()) {
+    const size_t length = std::min(max_frame_size, payload.size() - offset);
+    uint8_t header[MAX_HEADER_SIZE];
+    const size_t header_size = encode_header(header, first ? opcode : OpCode::CONTINUATION,
+                                             offset + length == payload.size(), length, first && compressed);
+    out.append(reinterpret_cast<const char *>(header), header_size);
+    out.append(reinterpret_cast<const char *>(payload.data() + offset), length);
+    offset += length;
+    first = false;
   }
-  byte1 |= static_cast<uint8_t>(opcode) & 0x0F;
-  header.push_back(byte1);
+}
 
-  const uint64_t payloadLen = data.size();
-  if (payloadLen < 126) {
-    header.push_back(static_cast<uint8_t>(payloadLen));
-  } else if (payloadLen <= 0xFFFF) {
-    header.push_back(126);
-    const uint16_t len16 = htons(static_cast<uint16_t>(payloadLen));
-    header.push_back(len16 >> 8 & 0xFF);
-    header.push_back(len16 & 0xFF);
-  } else {
-    header.push_back(127);
-    const uint64_t len64 = htobe64(payloadLen);
-    for (int i = 0; i < 8; ++i) {
-      header.push_back(len64 >> 56 - 8 * i & 0xFF);
+bool WebSocket::write_some(iovec *&iov, int &iov_count) const {
+  while (iov_count > 0) {
+    msghdr message{};
+    message.msg_iov = iov;
+    message.msg_iovlen = iov_count;
+    const ssize_t n = sendmsg(socket_fd_, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return false;
+      }
+      throw std::runtime_error(std::string("Failed to send WebSocket frame: ") + strerror(errno));
     }
-  }
 
-  size_t sent = 0;
-  while (sent < header.size()) {
-    const ssize_t n = ::send(socket_fd_, header.data() + sent, header.size() - sent, 0);
-    if (n < 0) {
-      throw std::runtime_error("Failed to send WebSocket frame header");
+    auto written = static_cast<size_t>(n);
+    while (iov_count > 0 && written >= iov->iov_len) {
+      written -= iov->iov_len;
+      ++iov;
+      --iov_count;
+    }
+    if (iov_count > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+      iov->iov_len -= written;
     }
-    sent += n;
   }
+  return true;
+}
 
-  sent = 0;
-  while (sent < data.size()) {
-    const ssize_t n = ::send(socket_fd_, data.data() + sent, data.size() - sent, 0);
-    if (n < 0) {
-      throw std::runtime_error("Failed to send WebSocket frame payload");
+WebSocket::SendStatus WebSocket::enqueue(EncodedMessage frames) {
+  if (outbound_size_ + frames->size() > parameters_.high_water_mark) {
+    switch (parameters_.slow_consumer_policy) {
+    case SlowConsumerPolicy::DROP_NEWEST:
+      return SendStatus::DROPPED;
+    case SlowConsumerPolicy::DISCONNECT:
+      shutdown(socket_fd_, SHUT_RDWR);
+      return SendStatus::DROPPED;
+    case SlowConsumerPolicy::DROP_OLDEST:
+      // A newest message larger than the mark on its own is still kept.
+      while (outbound_.size() > 1 && outbound_size_ + frames->size() > parameters_.high_water_mark) {
+        const auto oldest = std::next(outbound_.begin());
+        outbound_size_ -= (*oldest)->size();
+        outbound_.erase(oldest);
+      }
+      break;
     }
-    sent += n;
   }
+  outbound_size_ += frames->size();
+  outbound_.push_back(std::move(frames));
+  return SendStatus::QUEUED;
 }
 
-std::vector<uint8_t> WebSocket::parse_frame(bool &out_final, uint8_t &out_opcode) const {
-  uint8_t header[2];
-  size_t n = recv(socket_fd_, header, sizeof(header), MSG_WAITALL);
-  if (n != sizeof(header)) {
-    throw std::runtime_error("Failed to read WebSocket frame header");
+void WebSocket::set_write_interest(const bool interested) {
+  if (write_interest_ == interested) {
+    return;
   }
+  write_interest_ = interested;
+  if (write_interest_handler_) {
+    write_interest_handler_(interested);
+  }
+}
 
-  const bool fin = (header[0] & 0x80) != 0;
-  const uint8_t opcode = header[0] & 0x0F;
-  const bool mask = (header[1] & 0x80) != 0;
-  uint64_t payloadLen = header[1] & 0x7F;
+size_t WebSocket::frame_size_limit(const OpCode opcode) {
+  return opcode == OpCode::BINARY ? MAX_BINARY_FRAME_SIZE : std::numeric_limits<size_t>::max();
+}
 
-  if (payloadLen == 126) {
-    uint16_t len16;
-    n = recv(socket_fd_, &len16, sizeof(len16), MSG_WAITALL);
-    if (n != sizeof(len16)) {
-      throw std::runtime_error("Failed to read WebSocket frame length");
-    }
-    payloadLen = ntohs(len16);
-  } else if (payloadLen == 127) {
-    uint64_t len64;
-    n = recv(socket_fd_, &len64, sizeof(len64), MSG_WAITALL);
-    if (n != sizeof(len64)) {
-      throw std::runtime_error("Failed to read WebSocket frame length");
-    }
-    payloadLen = be64toh(len64);
+size_t WebSocket::encode_header(uint8_t *header, const OpCode opcode, const bool is_final,
+                                const uint64_t payload_length, const bool compressed) {
+  // RSV1 marks the first frame of a permessage-deflate message.
+  header[0] = static_cast<uint8_t>((is_final ? 0x80 : 0x00) | (compressed ? 0x40 : 0x00) |
+                                   (static_cast<uint8_t>(opcode) & 0x0F));
+  if (payload_length < 126) {
+    header[1] = static_cast<uint8_t>(payload_length);
+    return 2;
   }
-
-  uint8_t maskKey[4] = {};
-  if (mask) {
-    n = recv(socket_fd_, maskKey, sizeof(maskKey), MSG_WAITALL);
-    if (n != sizeof(maskKey)) {
-      throw std::runtime_error("Failed to read WebSocket frame mask key");
-    }
+  // Extended lengths are in network byte order.
+  const size_t length_bytes = payload_length <= 0xFFFF ? 2 : 8;
+  header[1] = length_bytes == 2 ? 126 : 127;
+  for (size_t i = 0; i < length_bytes; ++i) {
+    header[2 + i] = static_cast<uint8_t>(payload_length >> 8 * (length_bytes - 1 - i));
   }
+  return 2 + length_bytes;
+}
 
-  // Read payload data
-  std::vector<uint8_t> payload(payloadLen);
-  if (payloadLen > 0) {
-    n = recv(socket_fd_, payload.data(), payloadLen, MSG_WAITALL);
-    if (n != static_cast<ssize_t>(payloadLen)) {
-      throw std::runtime_error("Failed to read WebSocket frame payload");
-    }
+bool WebSocket::decode_header() {
+  const uint8_t *data = receive_buffer_.data() + receive_begin_;
+  const size_t available = receive_end_ - receive_begin_;
+  if (available < 2) {
+    return false;
   }
-
-  if (mask) {
-    for (uint64_t i = 0; i < payloadLen; ++i) {
-      payload[i] ^= maskKey[i % 4];
-    }
+  const bool masked = (data[1] & 0x80) != 0;
+  const uint8_t length_code = data[1] & 0x7F;
+  const size_t length_size = length_code == 126 ? 2 : length_code == 127 ? 8 : 0;
+  const size_t header_size = 2 + length_size + (masked ? 4 : 0);
+  if (available < header_size) {
+    return false;
   }
 
-  if (opcode == 0x8) {
-    throw std::runtime_error("Connection close frame received");
+  uint64_t payload_length = length_code;
+  if (length_code == 126) {
+    uint16_t len16;
+    std::memcpy(&len16, data + 2, sizeof(len16));
+    payload_length = ntohs(len16);
+  } else if (length_code == 127) {
+    uint64_t len64;
+    std::memcpy(&len64, data + 2, sizeof(len64));
+    payload_length = be64toh(len64);
   }
-  if (opcode == 0x9) {
-    // TODO: Handle ping frame
-    throw std::runtime_error("Make a pong");
+
+  const bool fin = (data[0] & 0x80) != 0;
+  const uint8_t opcode = data[0] & 0x0F;
+  // RSV1 is only defined for the first frame of a message when permessage-deflate was negotiated.
+  const bool compressed = (data[0] & 0x40) != 0;
+  if ((data[0] & 0x30) != 0 || (compressed && (!deflate_ || (opcode != 0x1 && opcode != 0x2)))) {
+    throw std::runtime_error("WebSocket frame uses reserved bits");
   }
-  if (opcode == 0xA) {
-    // Pong: ignore
+  if ((opcode & 0x8) != 0) {
+    if (opcode != 0x8 && opcode != 0x9 && opcode != 0xA) {
+      throw std::runtime_error("Unknown WebSocket control opcode");
+    }
+    if (!fin || payload_length > 125) {
+      throw std::runtime_error("Control frames must be final and at most 125 bytes");
+    }
+  } else {
+    if (opcode == 0x0) {
+      if (message_opcode_ == 0) {
+        throw std::runtime_error("Unexpected continuation frame");
+      }
+    } else if (opcode == 0x1 || opcode == 0x2) {
+      if (message_opcode_ != 0) {
+        throw std::runtime_error("Expected continuation frame");
+      }
+      message_opcode_ = opcode;
+      message_compressed_ = compressed;
+    } else {
+      throw std::runtime_error("Unknown WebSocket data opcode");
+    }
+    if (payload_length > MAX_MESSAGE_SIZE - message_buffer_.size()) {
+      throw std::runtime_error("WebSocket message too large");
+    }
   }
 
-  out_final = fin;
-  out_opcode = opcode;
-  return payload;
+  frame_.fin = fin;
+  frame_.opcode = opcode;
+  frame_.masked = masked;
+  if (masked) {
+    std::memcpy(frame_.masking_key, data + 2 + length_size, sizeof(frame_.masking_key));
+  }
+  frame_.remaining = payload_length;
+  frame_.received = 0;
+  frame_.stage = DecodeStage::PAYLOAD;
+  receive_begin_ += header_size;
+  return true;
 }
 
 WebSocket::OpCode WebSocket::to_opcode(const uint8_t raw) const {
@@ -0,0 +1,302 @@
+#include <server/WebSocketDeflate.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <server/HttpHeaders.hpp>
+#include <stdexcept>
+
+#ifdef LWS_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+// zlib cannot produce raw deflate data with a 256-byte window, so 8 bits is never agreed to.
+static constexpr int MIN_WINDOW_BITS = 9;
+static constexpr int MAX_WINDOW_BITS = 15;
+
+static std::string_view trim(std::string_view str) {
+  while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+    str.remove_prefix(1);
+  }
+  while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+    str.remove_suffix(1);
+  }
+  return str;
+}
+
+static std::string_view next_item(std::string_view &list, const char separator) {
+  const size_t end = list.find(separator);
+  const std::string_view item = trim(list.substr(0, end));
+  list = end == std::string_view::npos ? std::string_view{} : list.substr(end + 1);
+  return item;
+}
+
+// A window bits value, possibly quoted; 0 when it is not a number from 8 to 15.
+static int parse_window_bits(std::string_view value) {
+  if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+    value = value.substr(1, value.size() - 2);
+  }
+  int bits = 0;
+  const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), bits);
+  if (error != std::errc{} || end != value.data() + value.size() || bits < 8 || bits > MAX_WINDOW_BITS) {
+    return 0;
+  }
+  return bits;
+}
+
+static bool parse_offer(std::string_view offer, const WebSocketDeflate::Parameters &parameters,
+                        WebSocketDeflate::Agreement &agreement) {
+  if (!ascii_iequals(next_item(offer, ';'), "permessage-deflate")) {
+    return false;
+  }
+  const int max_window_bits = std::clamp(parameters.max_window_bits, MIN_WINDOW_BITS, MAX_WINDOW_BITS);
+  agreement = {.server_no_context_takeover = parameters.server_no_context_takeover,
+               .server_max_window_bits = max_window_bits,
+               .client_max_window_bits = MAX_WINDOW_BITS,
+               .mem_level = std::clamp(parameters.mem_level, 1, 9)};
+
+  bool seen[4] = {};
+  while (!offer.empty()) {
+    const std::string_view parameter = next_item(offer, ';');
+    const size_t equals = parameter.find('=');
+    const bool has_value = equals != std::string_view::npos;
+    const std::string_view name = trim(parameter.substr(0, equals));
+    const std::string_view value = has_value ? trim(parameter.substr(equals + 1)) : std::string_view{};
+    int index;
+    if (name == "server_no_context_takeover" && !has_value) {
+      index = 0;
+      agreement.server_no_context_takeover = true;
+    } else if (name == "client_no_context_takeover" && !has_value) {
+      index = 1;
+      agreement.client_no_context_takeover = true;
+    } else if (name == "server_max_window_bits" && has_value) {
+      index = 2;
+      const int bits = parse_window_bits(value);
+      if (bits < MIN_WINDOW_BITS) {
+        return false;
+      }
+      agreement.server_max_window_bits_offered = true;
+      agreement.server_max_window_bits = std::min(agreement.server_max_window_bits, bits);
+    } else if (name == "client_max_window_bits") {
+      index = 3;
+      const int bits = has_value ? parse_window_bits(value) : MAX_WINDOW_BITS;
+      if (bits == 0) {
+        return false;
+      }
+      agreement.client_max_window_bits_offered = true;
+      agreement.client_max_window_bits = std::min(max_window_bits, bits);
+    } else {
+      return false;
+    }
+    if (seen[index]) {
+      return false;
+    }
+    seen[index] = true;
+  }
+
+  // Halve whichever buffer is largest until the estimate fits; the client's window only if it let us. The
+  // exponents compared are those of the client window, the deflate window and the deflate hash chains.
+  int &server_bits = agreement.server_max_window_bits;
+  int &client_bits = agreement.client_max_window_bits;
+  int &mem_level = agreement.mem_level;
+  while (WebSocketDeflate::estimated_memory(server_bits, client_bits, mem_level) > parameters.max_memory) {
+    const bool client_shrinkable = agreement.client_max_window_bits_offered && client_bits > MIN_WINDOW_BITS;
+    if (client_shrinkable && client_bits > server_bits + 2 && client_bits > mem_level + 9) {
+      --client_bits;
+    } else if (server_bits > MIN_WINDOW_BITS && server_bits + 2 >= mem_level + 9) {
+      --server_bits;
+    } else if (mem_level > 1) {
+      --mem_level;
+    } else if (server_bits > MIN_WINDOW_BITS) {
+      --server_bits;
+    } else if (client_shrinkable) {
+      --client_bits;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::optional<WebSocketDeflate::Agreement> WebSocketDeflate::negotiate(std::string_view offers,
+                                                                       const Parameters &parameters) {
+#ifdef LWS_HAS_ZLIB
+  if (!parameters.enabled) {
+    return std::nullopt;
+  }
+  while (!offers.empty()) {
+    Agreement agreement;
+    if (parse_offer(next_item(offers, ','), parameters, agreement)) {
+      return agreement;
+    }
+  }
+#else
+  (void)offers;
+  (void)parameters;
+#endif
+  return std::nullopt;
+}
+
+std::string WebSocketDeflate::response_header(const Agreement &agreement) {
+  std::string header = "permessage-deflate";
+  if (agreement.server_no_context_takeover) {
+    header += "; server_no_context_takeover";
+  }
+  if (agreement.client_no_context_takeover) {
+    header += "; client_no_context_takeover";
+  }
+  if (agreement.server_max_window_bits_offered) {
+    header += "; server_max_window_bits=" + std::to_string(agreement.server_max_window_bits);
+  }
+  if (agreement.client_max_window_bits_offered) {
+    header += "; client_max_window_bits=" + std::to_string(agreement.client_max_window_bits);
+  }
+  return header;
+}
+
+size_t WebSocketDeflate::estimated_memory(const int server_window_bits, const int client_window_bits,
+                                          const int mem_level) {
+  // zconf.h: deflate needs (1 << (windowBits + 2)) + (1 << (memLevel + 9)) bytes, inflate 1 << windowBits plus
+  // about 7 KB of state.
+  return (size_t{1} << (server_window_bits + 2)) + (size_t{1} << (mem_level + 9)) +
+         (size_t{1} << client_window_bits) + 7 * 1024;
+}
+
+#ifdef LWS_HAS_ZLIB
+
+struct WebSocketDeflate::Streams {
+  z_stream deflater{};
+  z_stream inflater{};
+};
+
+static void init_deflater(z_stream &stream, const int level, const int window_bits, const int mem_level) {
+  // Negative window bits select raw deflate data without the zlib header and trailer.
+  if (deflateInit2(&stream, level, Z_DEFLATED, -window_bits, mem_level, Z_DEFAULT_STRATEGY) != Z_OK) {
+    throw std::runtime_error("deflateInit2 failed");
+  }
+}
+
+static void deflate_message(z_stream &stream, const std::string_view message, std::string &out) {
+  const size_t start = out.size();
+  size_t produced = start;
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(message.data()));
+  stream.avail_in = message.size();
+  do {
+    out.resize(produced + deflateBound(&stream, stream.avail_in) + 16);
+    stream.next_out = reinterpret_cast<Bytef *>(out.data() + produced);
+    stream.avail_out = out.size() - produced;
+    const int result = deflate(&stream, Z_SYNC_FLUSH);
+    if (result != Z_OK && result != Z_BUF_ERROR) {
+      throw std::runtime_error("deflate failed");
+    }
+    produced = out.size() - stream.avail_out;
+  } while (stream.avail_out == 0);
+  out.resize(produced);
+  // The flush ends in an empty stored block, 00 00 FF FF, which is left off the wire.
+  if (produced - start >= 4 && out.compare(produced - 4, 4, "\x00\x00\xFF\xFF", 4) == 0) {
+    out.resize(produced - 4);
+  }
+}
+
+std::string WebSocketDeflate::compress_once(const std::string_view message, const int window_bits, const int level,
+                                            const int mem_level) {
+  z_stream stream{};
+  init_deflater(stream, level, window_bits, mem_level);
+  std::string out;
+  try {
+    deflate_message(stream, message, out);
+  } catch (...) {
+    deflateEnd(&stream);
+    throw;
+  }
+  deflateEnd(&stream);
+  return out;
+}
+
+WebSocketDeflate::WebSocketDeflate(const Agreement &agreement, const Parameters &parameters)
+    : agreement_{agreement}, parameters_{parameters}, streams_{std::make_unique<Streams>()} {
+  init_deflater(streams_->deflater, parameters_.level, agreement_.server_max_window_bits, agreement_.mem_level);
+  if (inflateInit2(&streams_->inflater, -std::max(agreement_.client_max_window_bits, MIN_WINDOW_BITS)) != Z_OK) {
+    deflateEnd(&streams_->deflater);
+    throw std::runtime_error("inflateInit2 failed");
+  }
+}
+
+WebSocketDeflate::~WebSocketDeflate() {
+  deflateEnd(&streams_->deflater);
+  inflateEnd(&streams_->inflater);
+}
+
+void WebSocketDeflate::compress(const std::string_view message, std::string &out) {
+  deflate_message(streams_->deflater, message, out);
+  if (agreement_.server_no_context_takeover) {
+    deflateReset(&streams_->deflater);
+  }
+}
+
+std::string WebSocketDeflate::decompress(const std::string_view compressed, const size_t max_size) {
+  static constexpr unsigned char TAIL[4] = {0x00, 0x00, 0xFF, 0xFF};
+  z_stream &stream = streams_->inflater;
+  std::string out;
+  size_t produced = 0;
+  bool ended = false;
+  for (const std::string_view input: {compressed, std::string_view{reinterpret_cast<const char *>(TAIL), 4}}) {
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+    stream.avail_in = input.size();
+    while (!ended && (stream.avail_in > 0 || produced == out.size())) {
+      if (produced == out.size()) {
+        out.resize(produced + std::min(max_size + 1 - produced, std::max<size_t>(compressed.size() * 4, 4096)));
+      }
+      stream.next_out = reinterpret_cast<Bytef *>(out.data() + produced);
+      stream.avail_out = out.size() - produced;
+      const int result = inflate(&stream, Z_SYNC_FLUSH);
+      if (result == Z_BUF_ERROR) {
+        break;
+      }
+      if (result != Z_OK && result != Z_STREAM_END) {
+        inflateReset(&stream);
+        throw std::runtime_error("Corrupt permessage-deflate data");
+      }
+      produced = out.size() - stream.avail_out;
+      if (produced > max_size) {
+        inflateReset(&stream);
+        throw std::runtime_error("WebSocket message too large");
+      }
+      // A sender may finish with a final block; whatever follows it is the appended tail.
+      ended = result == Z_STREAM_END;
+    }
+  }
+  out.resize(produced);
+  if (ended || agreement_.client_no_context_takeover) {
+    inflateReset(&stream);
+  }
+  return out;
+}
+
+#else
+
+struct WebSocketDeflate::Streams {};
+
+std::string WebSocketDeflate::compress_once(std::string_view, int, int, int) {
+  throw std::runtime_error("lws was built without zlib");
+}
+
+WebSocketDeflate::WebSocketDeflate(const Agreement &agreement, const Parameters &parameters)
+    : agreement_{agreement}, parameters_{parameters} {
+  throw std::runtime_error("lws was built without zlib");
+}
+
+WebSocketDeflate::~WebSocketDeflate() = default;
+
+void WebSocketDeflate::compress(std::string_view, std::string &) {
+  throw std::runtime_error("lws was built without zlib");
+}
+
+std::string WebSocketDeflate::decompress(std::string_view, size_t) {
+  throw std::runtime_error("lws was built without zlib");
+}
+
+#endif
+
+const WebSocketDeflate::Agreement &WebSocketDeflate::agreement() const { return agreement_; }
+
+const WebSocketDeflate::Parameters &WebSocketDeflate::parameters() const { return parameters_; }
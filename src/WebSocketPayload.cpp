@@ -0,0 +1,341 @@
+#include <server/WebSocketPayload.hpp>
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// The key rotated so that its first byte applies to data[0]. Vector kernels broadcast it and only ever advance
+// in multiples of four bytes, so the rotation holds for their scalar tails too.
+static uint32_t rotated_key(const uint8_t (&masking_key)[4], const uint64_t offset) {
+  uint8_t bytes[4];
+  for (size_t i = 0; i < 4; ++i) {
+    bytes[i] = masking_key[(offset + i) % 4];
+  }
+  uint32_t key;
+  std::memcpy(&key, bytes, sizeof(key));
+  return key;
+}
+
+static void unmask_scalar(char *data, const size_t size, const uint32_t key) {
+  const uint64_t key64 = static_cast<uint64_t>(key) << 32 | key;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    word ^= key64;
+    std::memcpy(data + i, &word, sizeof(word));
+  }
+  uint8_t bytes[4];
+  std::memcpy(bytes, &key, sizeof(bytes));
+  for (size_t j = 0; i < size; ++i, ++j) {
+    data[i] = static_cast<char>(data[i] ^ bytes[j % 4]);
+  }
+}
+
+static bool is_valid_utf8_scalar(const unsigned char *data, const size_t size) {
+  size_t i = 0;
+  while (i < size) {
+    if (i + 8 <= size) {
+      uint64_t word;
+      std::memcpy(&word, data + i, sizeof(word));
+      if ((word & 0x8080808080808080ULL) == 0) {
+        i += 8;
+        continue;
+      }
+    }
+    const unsigned char lead = data[i];
+    if (lead < 0x80) {
+      ++i;
+      continue;
+    }
+
+    size_t length;
+    unsigned char min_second = 0x80;
+    unsigned char max_second = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+      length = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+      length = 3;
+      if (lead == 0xE0) {
+        min_second = 0xA0;
+      } else if (lead == 0xED) {
+        max_second = 0x9F;
+      }
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+      length = 4;
+      if (lead == 0xF0) {
+        min_second = 0x90;
+      } else if (lead == 0xF4) {
+        max_second = 0x8F;
+      }
+    } else {
+      return false;
+    }
+
+    if (size - i < length || data[i + 1] < min_second || data[i + 1] > max_second) {
+      return false;
+    }
+    for (size_t j = 2; j < length; ++j) {
+      if ((data[i + j] & 0xC0) != 0x80) {
+        return false;
+      }
+    }
+    i += length;
+  }
+  return true;
+}
+
+#if defined(__x86_64__)
+
+static void unmask_sse2(char *data, const size_t size, const uint32_t key) {
+  const __m128i mask = _mm_set1_epi32(static_cast<int>(key));
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    auto *block = reinterpret_cast<__m128i *>(data + i);
+    _mm_storeu_si128(block, _mm_xor_si128(_mm_loadu_si128(block), mask));
+  }
+  unmask_scalar(data + i, size - i, key);
+}
+
+__attribute__((target("avx2"))) static void unmask_avx2(char *data, const size_t size, const uint32_t key) {
+  const __m256i mask = _mm256_set1_epi32(static_cast<int>(key));
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    auto *block = reinterpret_cast<__m256i *>(data + i);
+    _mm256_storeu_si256(block, _mm256_xor_si256(_mm256_loadu_si256(block), mask));
+  }
+  unmask_scalar(data + i, size - i, key);
+}
+
+__attribute__((target("avx512f"))) static void unmask_avx512(char *data, const size_t size, const uint32_t key) {
+  const __m512i mask = _mm512_set1_epi32(static_cast<int>(key));
+  size_t i = 0;
+  for (; i + 64 <= size; i += 64) {
+    _mm512_storeu_si512(data + i, _mm512_xor_si512(_mm512_loadu_si512(data + i), mask));
+  }
+  unmask_scalar(data + i, size - i, key);
+}
+
+// Error classes of a (previous byte, current byte) pair, looked up by the high and low nibble of the previous
+// byte and the high nibble of the current one; a pair is invalid when all three lookups share a bit.
+static constexpr uint8_t TOO_SHORT = 1 << 0;
+static constexpr uint8_t TOO_LONG = 1 << 1;
+static constexpr uint8_t OVERLONG_3 = 1 << 2;
+static constexpr uint8_t TOO_LARGE = 1 << 3;
+static constexpr uint8_t SURROGATE = 1 << 4;
+static constexpr uint8_t OVERLONG_2 = 1 << 5;
+static constexpr uint8_t TOO_LARGE_1000 = 1 << 6;
+static constexpr uint8_t OVERLONG_4 = 1 << 6;
+static constexpr uint8_t TWO_CONTS = 1 << 7;
+static constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+struct Utf8Tables {
+  uint8_t byte_1_high[16];
+  uint8_t byte_1_low[16];
+  uint8_t byte_2_high[16];
+};
+
+static constexpr Utf8Tables UTF8_TABLES{
+    .byte_1_high = {TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TWO_CONTS,
+                    TWO_CONTS, TWO_CONTS, TWO_CONTS, TOO_SHORT | OVERLONG_2, TOO_SHORT,
+                    TOO_SHORT | OVERLONG_3 | SURROGATE, TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4},
+    .byte_1_low = {CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, CARRY | OVERLONG_2, CARRY, CARRY,
+                   CARRY | TOO_LARGE, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+                   CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+                   CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+                   CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+                   CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE, CARRY | TOO_LARGE | TOO_LARGE_1000,
+                   CARRY | TOO_LARGE | TOO_LARGE_1000},
+    .byte_2_high = {TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+                    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+                    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+                    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+                    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+                    TOO_SHORT},
+};
+
+struct Utf8StateAvx2 {
+  __m256i error;
+  __m256i prev_input;
+  __m256i prev_incomplete;
+};
+
+__attribute__((target("avx2"))) static __m256i broadcast_table(const uint8_t (&table)[16]) {
+  return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(table)));
+}
+
+// The input shifted right by n bytes across the lane boundary, with the last bytes of the previous block in front.
+template <int N> __attribute__((target("avx2"))) static __m256i previous(const __m256i input, const __m256i prev) {
+  return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+}
+
+__attribute__((target("avx2"))) static void check_block_avx2(Utf8StateAvx2 &state, const __m256i input) {
+  if (_mm256_movemask_epi8(input) == 0) {
+    // ASCII after a lead byte that still wanted continuation bytes.
+    state.error = _mm256_or_si256(state.error, state.prev_incomplete);
+    state.prev_input = input;
+    return;
+  }
+
+  const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+  const __m256i prev1 = previous<1>(input, state.prev_input);
+  const __m256i byte_1_high = _mm256_shuffle_epi8(broadcast_table(UTF8_TABLES.byte_1_high),
+                                                  _mm256_and_si256(_mm256_srli_epi16(prev1, 4), low_nibble));
+  const __m256i byte_1_low =
+      _mm256_shuffle_epi8(broadcast_table(UTF8_TABLES.byte_1_low), _mm256_and_si256(prev1, low_nibble));
+  const __m256i byte_2_high = _mm256_shuffle_epi8(broadcast_table(UTF8_TABLES.byte_2_high),
+                                                  _mm256_and_si256(_mm256_srli_epi16(input, 4), low_nibble));
+  const __m256i special_cases = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+  // Third and fourth bytes of a sequence are the only places where two continuations in a row are expected.
+  const __m256i is_third_byte = _mm256_subs_epu8(previous<2>(input, state.prev_input), _mm256_set1_epi8(0xE0 - 0x80));
+  const __m256i is_fourth_byte =
+      _mm256_subs_epu8(previous<3>(input, state.prev_input), _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+  const __m256i must_be_continuation =
+      _mm256_and_si256(_mm256_or_si256(is_third_byte, is_fourth_byte), _mm256_set1_epi8(static_cast<char>(0x80)));
+  state.error = _mm256_or_si256(state.error, _mm256_xor_si256(must_be_continuation, special_cases));
+
+  // Lead bytes in the last three positions whose sequence runs past this block.
+  const __m256i max_value = _mm256_setr_epi8(
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+  state.prev_incomplete = _mm256_subs_epu8(input, max_value);
+  state.prev_input = input;
+}
+
+__attribute__((target("avx2"))) static bool is_valid_utf8_avx2(const char *data, const size_t size) {
+  if (size < 32) {
+    // Padding a single short block costs more than the scalar loop.
+    return is_valid_utf8_scalar(reinterpret_cast<const unsigned char *>(data), size);
+  }
+  Utf8StateAvx2 state{_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    check_block_avx2(state, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)));
+  }
+  if (i < size) {
+    // Zero padding is ASCII, so a sequence truncated by the end of the input still shows up as TOO_SHORT.
+    alignas(32) char tail[32] = {};
+    std::memcpy(tail, data + i, size - i);
+    check_block_avx2(state, _mm256_load_si256(reinterpret_cast<const __m256i *>(tail)));
+  }
+  state.error = _mm256_or_si256(state.error, state.prev_incomplete);
+  return _mm256_testz_si256(state.error, state.error) != 0;
+}
+
+#elif defined(__aarch64__)
+
+static void unmask_neon(char *data, const size_t size, const uint32_t key) {
+  const uint8x16_t mask = vreinterpretq_u8_u32(vdupq_n_u32(key));
+  size_t i = 0;
+  for (; i + 16 <= size; i += 16) {
+    auto *block = reinterpret_cast<uint8_t *>(data + i);
+    vst1q_u8(block, veorq_u8(vld1q_u8(block), mask));
+  }
+  unmask_scalar(data + i, size - i, key);
+}
+
+#endif
+
+static WebSocketPayload::Isa detect_isa() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return WebSocketPayload::Isa::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return WebSocketPayload::Isa::AVX2;
+  }
+  return WebSocketPayload::Isa::SSE2;
+#elif defined(__aarch64__)
+  return WebSocketPayload::Isa::NEON;
+#else
+  return WebSocketPayload::Isa::SCALAR;
+#endif
+}
+
+WebSocketPayload::Isa WebSocketPayload::detected_isa() {
+  static const Isa isa = detect_isa();
+  return isa;
+}
+
+bool WebSocketPayload::is_supported(const Isa isa) {
+  const Isa detected = detected_isa();
+  switch (isa) {
+  case Isa::SCALAR:
+    return true;
+  case Isa::SSE2:
+  case Isa::AVX2:
+  case Isa::AVX512:
+    return detected != Isa::SCALAR && detected != Isa::NEON && detected >= isa;
+  case Isa::NEON:
+    return detected == Isa::NEON;
+  }
+  return false;
+}
+
+using UnmaskKernel = void (*)(char *, size_t, uint32_t);
+using Utf8Kernel = bool (*)(const char *, size_t);
+
+static UnmaskKernel unmask_kernel(const WebSocketPayload::Isa isa) {
+  switch (isa) {
+#if defined(__x86_64__)
+  case WebSocketPayload::Isa::SSE2:
+    return unmask_sse2;
+  case WebSocketPayload::Isa::AVX2:
+    return unmask_avx2;
+  case WebSocketPayload::Isa::AVX512:
+    return unmask_avx512;
+#elif defined(__aarch64__)
+  case WebSocketPayload::Isa::NEON:
+    return unmask_neon;
+#endif
+  default:
+    return unmask_scalar;
+  }
+}
+
+static bool is_valid_utf8_bytes(const char *data, const size_t size) {
+  return is_valid_utf8_scalar(reinterpret_cast<const unsigned char *>(data), size);
+}
+
+static Utf8Kernel utf8_kernel(const WebSocketPayload::Isa isa) {
+#if defined(__x86_64__)
+  if (isa == WebSocketPayload::Isa::AVX2 || isa == WebSocketPayload::Isa::AVX512) {
+    return is_valid_utf8_avx2;
+  }
+#endif
+  return is_valid_utf8_bytes;
+}
+
+static void check_supported(const WebSocketPayload::Isa isa) {
+  if (!WebSocketPayload::is_supported(isa)) {
+    throw std::invalid_argument("Instruction set not supported by this CPU");
+  }
+}
+
+void WebSocketPayload::unmask(char *data, const size_t size, const uint8_t (&masking_key)[4], const uint64_t offset) {
+  static const UnmaskKernel kernel = unmask_kernel(detected_isa());
+  kernel(data, size, rotated_key(masking_key, offset));
+}
+
+void WebSocketPayload::unmask(const Isa isa, char *data, const size_t size, const uint8_t (&masking_key)[4],
+                              const uint64_t offset) {
+  check_supported(isa);
+  unmask_kernel(isa)(data, size, rotated_key(masking_key, offset));
+}
+
+bool WebSocketPayload::is_valid_utf8(const std::string_view text) {
+  static const Utf8Kernel kernel = utf8_kernel(detected_isa());
+  return kernel(text.data(), text.size());
+}
+
+bool WebSocketPayload::is_valid_utf8(const Isa isa, const std::string_view text) {
+  check_supported(isa);
+  return utf8_kernel(isa)(text.data(), text.size());
+}
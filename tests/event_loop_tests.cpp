@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include <server/EventLoop.hpp>
+#include <server/Task.hpp>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+// Runs the loop on its own thread for the lifetime of the fixture object.
+struct RunningLoop {
+    explicit RunningLoop(Threadpool *pool = nullptr)
+        : loop{{.listener = {.epoll_timeout = 10}}, pool}, thread{[this] { loop.run(); }} {}
+
+    ~RunningLoop() {
+        loop.stop();
+        thread.join();
+    }
+
+    EventLoop loop;
+    std::thread thread;
+};
+
+template <typename T> static DetachedTask complete(Task<T> task, std::promise<T> &done) {
+    try {
+        done.set_value(co_await task);
+    } catch (...) {
+        done.set_exception(std::current_exception());
+    }
+}
+
+static Task<int64_t> add(const int64_t a, const int64_t b) {
+    co_return a + b;
+}
+
+static Task<int64_t> sum_to(const int64_t n) {
+    int64_t sum = 0;
+    for (int64_t i = 1; i <= n; ++i) {
+        sum = co_await add(sum, i);
+    }
+    co_return sum;
+}
+
+static Task<int> fail() {
+    throw std::runtime_error("boom");
+    co_return 0;
+}
+
+TEST(TaskTest, ChainsNestedTasksWithoutGrowingTheStack) {
+    std::promise<int64_t> done;
+    complete(sum_to(1'000'000), done);
+    EXPECT_EQ(done.get_future().get(), 500'000'500'000);
+}
+
+TEST(TaskTest, RethrowsExceptionsFromCoAwait) {
+    std::promise<int> done;
+    complete(fail(), done);
+    EXPECT_THROW(done.get_future().get(), std::runtime_error);
+}
+
+static Task<std::chrono::steady_clock::time_point> sleep(EventLoop &loop, const std::chrono::milliseconds duration) {
+    co_await loop.sleep_for(duration);
+    co_return std::chrono::steady_clock::now();
+}
+
+TEST(EventLoopTest, ResumesSleepersAtTheirDeadlinesInOrder) {
+    RunningLoop running;
+    std::promise<std::chrono::steady_clock::time_point> slow;
+    std::promise<std::chrono::steady_clock::time_point> fast;
+    const auto start = std::chrono::steady_clock::now();
+    complete(sleep(running.loop, 120ms), slow);
+    complete(sleep(running.loop, 40ms), fast);
+
+    const auto fast_at = fast.get_future().get();
+    const auto slow_at = slow.get_future().get();
+    EXPECT_GE(fast_at - start, 40ms);
+    EXPECT_GE(slow_at - start, 120ms);
+    EXPECT_LT(fast_at, slow_at);
+}
+
+TEST(EventLoopTest, ThousandsOfSleepersShareOneWorker) {
+    Threadpool pool(1);
+    RunningLoop running{&pool};
+    constexpr int COUNT = 2000;
+    std::vector<std::promise<std::chrono::steady_clock::time_point>> done(COUNT);
+    const auto start = std::chrono::steady_clock::now();
+    for (auto &promise: done) {
+        complete(sleep(running.loop, 100ms), promise);
+    }
+    for (auto &promise: done) {
+        promise.get_future().get();
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 2s);
+}
+
+static Task<std::string> read_when_ready(EventLoop &loop, const int fd) {
+    co_await loop.readable(fd);
+    char buffer[16];
+    const ssize_t n = read(fd, buffer, sizeof(buffer));
+    co_return std::string(buffer, n > 0 ? n : 0);
+}
+
+TEST(EventLoopTest, ResumesReadersWhenTheFdBecomesReadable) {
+    RunningLoop running;
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+
+    std::promise<std::string> done;
+    auto result = done.get_future();
+    complete(read_when_ready(running.loop, fds[0]), done);
+    EXPECT_EQ(result.wait_for(50ms), std::future_status::timeout);
+
+    ASSERT_EQ(write(fds[1], "ping", 4), 4);
+    EXPECT_EQ(result.get(), "ping");
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(EventLoopTest, RejectsASecondWaiterOnTheSameFd) {
+    RunningLoop running;
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+
+    std::promise<std::string> first;
+    std::promise<std::string> second;
+    complete(read_when_ready(running.loop, fds[0]), first);
+    complete(read_when_ready(running.loop, fds[0]), second);
+    EXPECT_THROW(second.get_future().get(), std::invalid_argument);
+
+    ASSERT_EQ(write(fds[1], "x", 1), 1);
+    EXPECT_EQ(first.get_future().get(), "x");
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static Task<std::thread::id> offloaded(EventLoop &loop) {
+    co_await loop.offload();
+    co_return std::this_thread::get_id();
+}
+
+TEST(EventLoopTest, OffloadContinuesOnAPoolWorker) {
+    Threadpool pool(1);
+    RunningLoop running{&pool};
+    std::promise<std::thread::id> done;
+    complete(offloaded(running.loop), done);
+    EXPECT_NE(done.get_future().get(), std::this_thread::get_id());
+
+    RunningLoop without_pool;
+    std::promise<std::thread::id> inline_done;
+    complete(offloaded(without_pool.loop), inline_done);
+    EXPECT_EQ(inline_done.get_future().get(), std::this_thread::get_id());
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <server/Router.hpp>
+
+static HttpRequest make_request(const std::string &method, const std::string &path) {
+    return HttpRequest::parse_http_request(method + " " + path + " HTTP/1.1\r\n\r\n");
+}
+
+static Router::Handler reply(const std::string &text) {
+    return [text](const HttpRequest &) { return HttpResponse::Text(text); };
+}
+
+static std::string dispatch(const Router &router, HttpRequest &req) {
+    const Router::Route *route = router.match(req);
+    return route ? route->handler(req).body : "<none>";
+}
+
+TEST(RouterTest, PrefersExactStaticRoutes) {
+    Router router;
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/api/users", reply("users"));
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/api/user", reply("user"));
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/api", reply("api"));
+
+    HttpRequest users = make_request("GET", "/api/users");
+    HttpRequest user = make_request("GET", "/api/user");
+    HttpRequest api = make_request("GET", "/api");
+    EXPECT_EQ(dispatch(router, users), "users");
+    EXPECT_EQ(dispatch(router, user), "user");
+    EXPECT_EQ(dispatch(router, api), "api");
+}
+
+TEST(RouterTest, FallsBackToLongestPrefix) {
+    Router router;
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/", reply("root"));
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/assets", reply("assets"));
+
+    HttpRequest asset = make_request("GET", "/assets/app.js");
+    HttpRequest page = make_request("GET", "/index.html");
+    HttpRequest post = make_request("POST", "/assets/app.js");
+    EXPECT_EQ(dispatch(router, asset), "assets");
+    EXPECT_EQ(dispatch(router, page), "root");
+    EXPECT_EQ(dispatch(router, post), "<none>");
+}
+
+TEST(RouterTest, CapturesParamsAndWildcards) {
+    Router router;
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/users/:id", reply("user"));
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/users/:id/posts/:post", reply("post"));
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/users/me", reply("me"));
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/files/*path", reply("file"));
+
+    HttpRequest me = make_request("GET", "/users/me");
+    EXPECT_EQ(dispatch(router, me), "me");
+
+    HttpRequest post = make_request("GET", "/users/42/posts/7");
+    EXPECT_EQ(dispatch(router, post), "post");
+    EXPECT_EQ(post.path_param("id"), "42");
+    EXPECT_EQ(post.path_param("post"), "7");
+
+    HttpRequest file = make_request("GET", "/files/css/site.css");
+    EXPECT_EQ(dispatch(router, file), "file");
+    EXPECT_EQ(file.path_param("path"), "css/site.css");
+}
+
+TEST(RouterTest, RejectsConflictingParamNames) {
+    Router router;
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/users/:id", reply("user"));
+    EXPECT_THROW(router.add(HttpRequest::HttpMethod::HTTP_GET, "/users/:name/x", reply("x")), std::invalid_argument);
+    EXPECT_THROW(router.add(HttpRequest::HttpMethod::HTTP_GET, "/files/*path/x", reply("x")), std::invalid_argument);
+}
+
+TEST(RouterTest, RejectsConflictingWildcardNames) {
+    Router router;
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/files/*path", reply("file"));
+    EXPECT_THROW(router.add(HttpRequest::HttpMethod::HTTP_GET, "/files/*rest", reply("rest")), std::invalid_argument);
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/files/*path", reply("replaced"));
+
+    HttpRequest req = make_request("GET", "/files/a/b");
+    EXPECT_EQ(dispatch(router, req), "replaced");
+    EXPECT_EQ(req.path_param("path"), "a/b");
+}
+
+TEST(RouterTest, StoresCoroutineHandlersAlongsideSyncOnes) {
+    Router router;
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/sync", reply("sync"));
+    router.add(HttpRequest::HttpMethod::HTTP_GET, "/async", [](const HttpRequest &) -> Task<HttpResponse> {
+        co_return HttpResponse::Text("async");
+    });
+
+    HttpRequest sync = make_request("GET", "/sync");
+    HttpRequest async = make_request("GET", "/async");
+    const Router::Route *sync_route = router.match(sync);
+    const Router::Route *async_route = router.match(async);
+    ASSERT_TRUE(sync_route && async_route);
+    EXPECT_TRUE(sync_route->handler && !sync_route->async_handler);
+    EXPECT_TRUE(async_route->async_handler && !async_route->handler);
+}
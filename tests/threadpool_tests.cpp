@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include <server/Threadpool.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+
+static bool wait_until(const std::function<bool()> &done) {
+    for (int i = 0; i < 500 && !done(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return done();
+}
+
+TEST(ThreadpoolTest, RunsExternalAndNestedSubmissions) {
+    Threadpool pool(4);
+    std::atomic<int> executed{0};
+    for (int i = 0; i < 1000; ++i) {
+        pool.submit([&] {
+            ++executed;
+            for (int j = 0; j < 10; ++j) {
+                pool.submit([&] { ++executed; });
+            }
+        });
+    }
+    EXPECT_TRUE(wait_until([&] { return executed.load() == 11000; }));
+}
+
+TEST(ThreadpoolTest, DrainsQueuedTasksOnStop) {
+    Threadpool pool(2);
+    std::atomic<int> executed{0};
+    for (int i = 0; i < 200; ++i) {
+        pool.submit([&] {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            ++executed;
+        });
+    }
+    pool.request_stop();
+    pool.wait_for_exit();
+    EXPECT_EQ(executed.load(), 200);
+
+    pool.submit([&] { ++executed; });
+    EXPECT_EQ(executed.load(), 200);
+}
+
+TEST(ThreadpoolTest, WakesParkedWorkersAfterIdlePeriod) {
+    Threadpool pool(8);
+    std::atomic<int> executed{0};
+    for (int round = 0; round < 20; ++round) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        for (int i = 0; i < 50; ++i) {
+            pool.submit([&] { ++executed; });
+        }
+    }
+    EXPECT_TRUE(wait_until([&] { return executed.load() == 1000; }));
+}
+
+TEST(JobTest, StoresSmallAndMoveOnlyCallablesInline) {
+    int calls = 0;
+    auto owned = std::make_unique<int>(41);
+    Job job{[&calls, owned = std::move(owned)] { calls += *owned + 1; }};
+    EXPECT_TRUE(job.is_inline());
+
+    Job moved = std::move(job);
+    EXPECT_FALSE(job);
+    moved();
+    EXPECT_EQ(calls, 42);
+
+    std::array<char, Job::INLINE_SIZE> exactly_inline{};
+    exactly_inline[0] = 1;
+    Job small{[exactly_inline] { (void)exactly_inline; }};
+    EXPECT_TRUE(small.is_inline());
+
+    Job large{[&calls, exactly_inline] { calls += exactly_inline[0]; }};
+    EXPECT_FALSE(large.is_inline());
+    Job moved_large = std::move(large);
+    moved_large();
+    EXPECT_EQ(calls, 43);
+}
+
+TEST(ThreadpoolTest, AcceptsMoveOnlyTasks) {
+    Threadpool pool(2);
+    std::atomic<int> sum{0};
+    for (int i = 0; i < 100; ++i) {
+        pool.submit([&sum, value = std::make_unique<int>(i)] { sum += *value; });
+    }
+    EXPECT_TRUE(wait_until([&] { return sum.load() == 4950; }));
+}
+
+TEST(ThreadpoolTest, RejectsBeyondCapacityAndBlocksUnderBlockPolicy) {
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<int> started{0};
+    std::atomic<int> executed{0};
+    auto task = [&] {
+        ++started;
+        released.wait();
+        ++executed;
+    };
+
+    // Capacity counts queued tasks: one runs, one waits, the third is turned away.
+    Threadpool rejecting({.num_threads = 1, .admission = {.capacity = 1}});
+    EXPECT_TRUE(rejecting.submit(task));
+    ASSERT_TRUE(wait_until([&] { return started.load() == 1; }));
+    EXPECT_TRUE(rejecting.submit(task));
+    EXPECT_FALSE(rejecting.submit(task));
+
+    Threadpool blocking({.num_threads = 1,
+                         .admission = {.capacity = 1, .policy = Threadpool::AdmissionPolicy::BLOCK}});
+    EXPECT_TRUE(blocking.submit(task));
+    ASSERT_TRUE(wait_until([&] { return started.load() == 2; }));
+    EXPECT_TRUE(blocking.submit(task));
+    std::atomic<bool> third_admitted{false};
+    std::thread submitter([&] { third_admitted = blocking.submit([&] { ++executed; }); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(third_admitted.load());
+
+    release.set_value();
+    submitter.join();
+    EXPECT_TRUE(third_admitted.load());
+    EXPECT_TRUE(wait_until([&] { return executed.load() == 5; }));
+}
+
+TEST(ThreadpoolTest, CoDelShedsWhileQueueingDelayStaysAboveTarget) {
+    using namespace std::chrono_literals;
+    Threadpool pool({.num_threads = 1,
+                     .admission = {.policy = Threadpool::AdmissionPolicy::CODEL, .target = 1ms, .interval = 10ms}});
+    std::atomic<int> executed{0};
+    int rejected = 0;
+    for (int i = 0; i < 200; ++i) {
+        if (!pool.submit([&] {
+                std::this_thread::sleep_for(2ms);
+                ++executed;
+            })) {
+            ++rejected;
+        }
+        std::this_thread::sleep_for(500us);
+    }
+    EXPECT_GT(rejected, 0);
+    EXPECT_TRUE(wait_until([&] { return executed.load() == 200 - rejected; }));
+
+    // Once the standing queue drains, work is admitted again.
+    EXPECT_TRUE(pool.submit([&] { ++executed; }));
+}
+
+TEST(ThreadpoolTest, PinsAndNamesWorkers) {
+    const std::vector<int> cores = ThreadPlacement::physical_cores();
+    ASSERT_FALSE(cores.empty());
+    const int cpu = cores.front();
+
+    Threadpool pool({.num_threads = 2, .affinity = {.cpus = {cpu}}, .name = "lws-test"});
+    std::promise<std::pair<int, std::string>> placement;
+    pool.submit([&] {
+        char name[16] = {0};
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        placement.set_value({sched_getcpu(), name});
+    });
+    const auto [ran_on, name] = placement.get_future().get();
+    EXPECT_EQ(ran_on, cpu);
+    EXPECT_TRUE(name == "lws-test-0" || name == "lws-test-1") << name;
+}
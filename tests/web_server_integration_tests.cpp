@@ -3,7 +3,12 @@
 #include <server/HttpRequest.hpp>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <arpa/inet.h>
 #include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <future>
 #include <thread>
 
 static WebServer::Parameters makeParams() {
@@ -21,6 +26,19 @@ static std::string extract_http_body(const std::string &raw_response) {
     return raw_response.substr(pos + 4);
 }
 
+static int connect_to(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
 TEST(OnHttpTest, DispatchesGetHandler) {
     WebServer server(makeParams());
     bool called = false;
@@ -95,6 +113,175 @@ TEST(OnHttpTest, DispatchesPostHandler) {
     close(fds[1]);
 }
 
+TEST(OnHttpTest, KeepsHttp11ConnectionOpen) {
+    WebServer server(makeParams());
+    server.get("/hello", [](const HttpRequest &) { return HttpResponse::Text("Hello", 200); });
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    const char *req = "GET /hello HTTP/1.1\r\nHost: test\r\n\r\n";
+    for (int i = 0; i < 2; ++i) {
+        write(fds[0], req, strlen(req));
+        server.on_http(fds[1]);
+        char buf[256] = {0};
+        ssize_t n = read(fds[0], buf, sizeof(buf) - 1);
+        ASSERT_GT(n, 0);
+        std::string response(buf);
+        EXPECT_NE(response.find("Connection: keep-alive"), std::string::npos);
+        EXPECT_EQ(extract_http_body(response), "Hello");
+    }
+    close(fds[0]);
+}
+
+TEST(OnHttpTest, ClosesHttp10ConnectionByDefault) {
+    WebServer server(makeParams());
+    server.get("/hello", [](const HttpRequest &) { return HttpResponse::Text("Hello", 200); });
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    const char *req = "GET /hello HTTP/1.0\r\n\r\n";
+    write(fds[0], req, strlen(req));
+    server.on_http(fds[1]);
+    char buf[256] = {0};
+    ssize_t n = read(fds[0], buf, sizeof(buf) - 1);
+    ASSERT_GT(n, 0);
+    EXPECT_NE(std::string(buf).find("Connection: close"), std::string::npos);
+    EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 0);
+    close(fds[0]);
+}
+
+TEST(OnHttpTest, ClosesConnectionAfterMaxKeepAliveRequests) {
+    WebServer::Parameters params = makeParams();
+    params.max_keep_alive_requests = 1;
+    WebServer server(params);
+    server.get("/hello", [](const HttpRequest &) { return HttpResponse::Text("Hello", 200); });
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    const char *req = "GET /hello HTTP/1.1\r\nHost: test\r\nConnection: keep-alive\r\n\r\n";
+    write(fds[0], req, strlen(req));
+    server.on_http(fds[1]);
+    char buf[256] = {0};
+    ssize_t n = read(fds[0], buf, sizeof(buf) - 1);
+    ASSERT_GT(n, 0);
+    EXPECT_NE(std::string(buf).find("Connection: close"), std::string::npos);
+    EXPECT_EQ(read(fds[0], buf, sizeof(buf)), 0);
+    close(fds[0]);
+}
+
+TEST(OnHttpTest, RejectsOversizedBodyWith413) {
+    WebServer::Parameters params = makeParams();
+    params.http_connection.max_body_size = 16;
+    WebServer server(params);
+    bool called = false;
+    server.post("/submit", [&](const HttpRequest &) {
+        called = true;
+        return HttpResponse::Text("Posted", 200);
+    });
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    const char *req = "POST /submit HTTP/1.1\r\nHost: test\r\nContent-Length: 1024\r\n\r\n";
+    write(fds[0], req, strlen(req));
+    server.on_http(fds[1]);
+    char buf[256] = {0};
+    ssize_t n = read(fds[0], buf, sizeof(buf) - 1);
+    ASSERT_GT(n, 0);
+    EXPECT_TRUE(std::string(buf).starts_with("HTTP/1.1 413"));
+    EXPECT_FALSE(called);
+    close(fds[0]);
+}
+
+TEST(OnHttpTest, WritesLargeResponseThroughShortWrites) {
+    WebServer server(makeParams());
+    const std::string payload(4 * 1024 * 1024, 'z');
+    server.get("/big", [&](const HttpRequest &) { return HttpResponse::Text(payload, 200); });
+    // The rest of the response is written once the keep-alive listener reports the socket writable.
+    server.run();
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    const char *req = "GET /big HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n";
+    write(fds[0], req, strlen(req));
+
+    std::thread worker([&] { server.on_http(fds[1]); });
+    std::string response;
+    char buf[64 * 1024];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+        response.append(buf, n);
+    }
+    worker.join();
+    EXPECT_EQ(extract_http_body(response), payload);
+    close(fds[0]);
+    server.request_stop();
+}
+
+TEST(OnHttpTest, StreamsFileBodyWithSendfile) {
+    const std::filesystem::path file_path = std::filesystem::temp_directory_path() / "lws_sendfile_test.bin";
+    std::string content;
+    for (int i = 0; i < 3 * 1024 * 1024; ++i) {
+        content += static_cast<char>('a' + i % 26);
+    }
+    {
+        std::ofstream out(file_path, std::ios::binary);
+        out << content;
+    }
+
+    WebServer server(makeParams());
+    server.get("/file", [&](const HttpRequest &) { return HttpResponse::FromFile(file_path.string(), "text/plain"); });
+    server.run();
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    const char *req = "GET /file HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n";
+    write(fds[0], req, strlen(req));
+
+    std::thread worker([&] { server.on_http(fds[1]); });
+    std::string response;
+    char buf[64 * 1024];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+        response.append(buf, n);
+    }
+    worker.join();
+    EXPECT_NE(response.find("Content-Length: " + std::to_string(content.size())), std::string::npos);
+    EXPECT_EQ(extract_http_body(response), content);
+    close(fds[0]);
+    server.request_stop();
+    std::filesystem::remove(file_path);
+}
+
+TEST(WebServerTest, ServesMultipleByteRangesFromStaticFile) {
+    const std::filesystem::path base = std::filesystem::temp_directory_path() / "lws_range_test";
+    std::filesystem::create_directories(base);
+    {
+        std::ofstream out(base / "video.bin", std::ios::binary);
+        out << "0123456789abcdefghij";
+    }
+
+    WebServer server(makeParams());
+    server.get("/", [&](const HttpRequest &req) { return HttpResponse::ServeStatic(base, req, "/"); });
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    const char *req = "GET /video.bin HTTP/1.1\r\nHost: test\r\nRange: bytes=2-4, -3\r\nConnection: close\r\n\r\n";
+    write(fds[0], req, strlen(req));
+
+    std::thread worker([&] { server.on_http(fds[1]); });
+    std::string response;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0) {
+        response.append(buf, n);
+    }
+    worker.join();
+    EXPECT_EQ(response.rfind("HTTP/1.1 206 Partial Content\r\n", 0), 0);
+    EXPECT_NE(response.find("Content-Type: multipart/byteranges; boundary="), std::string::npos);
+    const std::string body = extract_http_body(response);
+    EXPECT_NE(body.find("Content-Range: bytes 2-4/20\r\n\r\n234\r\n"), std::string::npos);
+    EXPECT_NE(body.find("Content-Range: bytes 17-19/20\r\n\r\nhij\r\n"), std::string::npos);
+    EXPECT_NE(response.find("Content-Length: " + std::to_string(body.size())), std::string::npos);
+    close(fds[0]);
+    std::filesystem::remove_all(base);
+}
+
 TEST(RunStopTest, CanStartAndStopWithoutCrashing) {
     WebServer server(makeParams());
     EXPECT_NO_THROW(server.run());
@@ -102,3 +289,180 @@ TEST(RunStopTest, CanStartAndStopWithoutCrashing) {
     EXPECT_NO_THROW(server.request_stop());
     EXPECT_NO_THROW(server.wait_for_exit());
 }
+
+TEST(ReactorTest, ServesKeepAliveRequestsOnReusePortLoops) {
+    WebServer::Parameters params = makeParams();
+    params.reactors = 2;
+    WebServer server(params);
+    server.get("/hello", [](const HttpRequest &) { return HttpResponse::Text("Hello", 200); });
+    server.run();
+    ASSERT_GT(server.get_port(), 0);
+
+    for (int c = 0; c < 4; ++c) {
+        int fd = connect_to(server.get_port());
+        ASSERT_GE(fd, 0);
+        const char *req = "GET /hello HTTP/1.1\r\nHost: test\r\n\r\n";
+        for (int i = 0; i < 2; ++i) {
+            write(fd, req, strlen(req));
+            char buf[256] = {0};
+            ssize_t n = read(fd, buf, sizeof(buf) - 1);
+            ASSERT_GT(n, 0);
+            EXPECT_EQ(extract_http_body(buf), "Hello");
+        }
+        close(fd);
+    }
+    EXPECT_NO_THROW(server.request_stop());
+}
+
+TEST(ReactorTest, SlowReaderDoesNotStallTheLoop) {
+    WebServer::Parameters params = makeParams();
+    params.reactors = 1;
+    WebServer server(params);
+    const std::string payload(16 * 1024 * 1024, 'z');
+    server.get("/big", [&](const HttpRequest &) { return HttpResponse::Text(payload, 200); });
+    server.get("/hello", [](const HttpRequest &) { return HttpResponse::Text("Hello", 200); });
+    server.run();
+
+    const int slow = connect_to(server.get_port());
+    ASSERT_GE(slow, 0);
+    const char *big = "GET /big HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n";
+    write(slow, big, strlen(big));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const int fast = connect_to(server.get_port());
+    ASSERT_GE(fast, 0);
+    const char *hello = "GET /hello HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n";
+    write(fast, hello, strlen(hello));
+    char buf[256] = {0};
+    ASSERT_GT(read(fast, buf, sizeof(buf) - 1), 0);
+    EXPECT_EQ(extract_http_body(buf), "Hello");
+    close(fast);
+
+    std::string response;
+    char chunk[64 * 1024];
+    ssize_t n;
+    while ((n = read(slow, chunk, sizeof(chunk))) > 0) {
+        response.append(chunk, n);
+    }
+    EXPECT_EQ(extract_http_body(response).size(), payload.size());
+    close(slow);
+    EXPECT_NO_THROW(server.request_stop());
+}
+
+TEST(AdmissionTest, ShedsConnectionsBeyondQueueCapacityWith503) {
+    WebServer::Parameters params = makeParams();
+    params.num_threads = 1;
+    params.admission = {.capacity = 1, .policy = Threadpool::AdmissionPolicy::REJECT};
+    params.overload_retry_after = 7;
+    WebServer server(params);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    server.get("/slow", [released](const HttpRequest &) {
+        released.wait();
+        return HttpResponse::Text("done", 200);
+    });
+    server.run();
+
+    const char *req = "GET /slow HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n";
+    int busy = connect_to(server.get_port());
+    write(busy, req, strlen(req));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int queued = connect_to(server.get_port());
+    write(queued, req, strlen(req));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int shed = connect_to(server.get_port());
+
+    char buf[512] = {0};
+    ssize_t n = read(shed, buf, sizeof(buf) - 1);
+    ASSERT_GT(n, 0);
+    EXPECT_EQ(std::string(buf).rfind("HTTP/1.1 503 Service Unavailable\r\n", 0), 0);
+    EXPECT_NE(std::string(buf).find("Retry-After: 7\r\n"), std::string::npos);
+
+    release.set_value();
+    for (const int fd: {busy, queued}) {
+        std::memset(buf, 0, sizeof(buf));
+        n = read(fd, buf, sizeof(buf) - 1);
+        ASSERT_GT(n, 0);
+        EXPECT_EQ(extract_http_body(buf), "done");
+        close(fd);
+    }
+    close(shed);
+    server.request_stop();
+    server.wait_for_exit();
+}
+
+TEST(AsyncRouteTest, ServesConcurrentSlowHandlersWithOneWorker) {
+    WebServer::Parameters params = makeParams();
+    params.num_threads = 1;
+    WebServer server(params);
+    server.get("/slow", [&loop = server.event_loop()](const HttpRequest &req) -> Task<HttpResponse> {
+        co_await loop.sleep_for(std::chrono::milliseconds(300));
+        co_return HttpResponse::Text("slept " + std::string{req.path}, 200);
+    });
+    server.get("/fail", [](const HttpRequest &) -> Task<HttpResponse> {
+        throw std::runtime_error("upstream unavailable");
+        co_return HttpResponse::Text("unreachable", 200);
+    });
+    server.run();
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<int> fds;
+    for (int i = 0; i < 8; ++i) {
+        const int fd = connect_to(server.get_port());
+        ASSERT_GE(fd, 0);
+        const char *req = "GET /slow HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n";
+        write(fd, req, strlen(req));
+        fds.push_back(fd);
+    }
+    for (const int fd: fds) {
+        char buf[512] = {0};
+        ASSERT_GT(read(fd, buf, sizeof(buf) - 1), 0);
+        EXPECT_EQ(extract_http_body(buf), "slept /slow");
+        close(fd);
+    }
+    // Eight sequential 300 ms handlers on one worker would take 2.4 s.
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1200));
+
+    const int fd = connect_to(server.get_port());
+    const char *req = "GET /fail HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n";
+    write(fd, req, strlen(req));
+    char buf[512] = {0};
+    ASSERT_GT(read(fd, buf, sizeof(buf) - 1), 0);
+    EXPECT_EQ(std::string(buf).rfind("HTTP/1.1 500", 0), 0);
+    close(fd);
+
+    server.request_stop();
+}
+
+TEST(AsyncRouteTest, KeepsPipelinedConnectionsAliveOnReactors) {
+    WebServer::Parameters params = makeParams();
+    params.reactors = 1;
+    WebServer server(params);
+    server.get("/async", [&loop = server.event_loop()](const HttpRequest &) -> Task<HttpResponse> {
+        co_await loop.sleep_for(std::chrono::milliseconds(20));
+        co_return HttpResponse::Text("async", 200);
+    });
+    server.get("/sync", [](const HttpRequest &) { return HttpResponse::Text("sync", 200); });
+    server.run();
+
+    const int fd = connect_to(server.get_port());
+    ASSERT_GE(fd, 0);
+    const std::string pipelined = "GET /async HTTP/1.1\r\nHost: test\r\n\r\nGET /sync HTTP/1.1\r\nHost: test\r\n\r\n";
+    write(fd, pipelined.data(), pipelined.size());
+    std::string received;
+    char buf[512];
+    while (received.find("sync", received.find("async") + 5) == std::string::npos) {
+        const ssize_t n = read(fd, buf, sizeof(buf));
+        ASSERT_GT(n, 0);
+        received.append(buf, n);
+    }
+    EXPECT_LT(received.find("async"), received.rfind("sync"));
+
+    const char *again = "GET /async HTTP/1.1\r\nHost: test\r\n\r\n";
+    write(fd, again, strlen(again));
+    const ssize_t n = read(fd, buf, sizeof(buf));
+    ASSERT_GT(n, 0);
+    EXPECT_EQ(extract_http_body(std::string(buf, n)), "async");
+    close(fd);
+    server.request_stop();
+}
@@ -1,8 +1,12 @@
 #include <gtest/gtest.h>
 #include <chrono>
 #include <iostream>
+#include <server/HttpConnection.hpp>
 #include <server/HttpRequest.hpp>
+#include <server/HttpTokenizer.hpp>
 #include <server/WebServer.hpp>
+#include <sys/socket.h>
+#include <thread>
 
 const std::string chunked_request =
     "POST /test HTTP/1.1\r\n"
@@ -36,6 +40,116 @@ static std::string generate_large_request_content_length(size_t size_in_bytes) {
     return oss.str();
 }
 
+TEST(HttpConnectionTest, DecodesChunkedBody) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    write(fds[0], chunked_request.c_str(), chunked_request.size());
+
+    HttpConnection connection{fds[1]};
+    ASSERT_EQ(connection.read_request({}), HttpConnection::ReadStatus::COMPLETE);
+    HttpRequest req = HttpRequest::parse_http_request(connection.take_request());
+    EXPECT_EQ(req.body, "Hello, world!");
+    EXPECT_FALSE(connection.has_buffered_data());
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(HttpConnectionTest, RejectsChunkSizesThatWouldOverflow) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    const std::string request = "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                                "4\r\nabcd\r\nfffffffffffffffe\r\nxy";
+    write(fds[0], request.c_str(), request.size());
+
+    HttpConnection connection{fds[1]};
+    EXPECT_EQ(connection.read_request({}), HttpConnection::ReadStatus::BODY_TOO_LARGE);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(HttpConnectionTest, ReassemblesSplitSegmentsAndKeepsPipelinedRequest) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    const std::string pipelined = length_request + "GET /next HTTP/1.1\r\n\r\n";
+    std::thread writer([&] {
+        for (char c: pipelined) {
+            write(fds[0], &c, 1);
+        }
+    });
+
+    HttpConnection connection{fds[1]};
+    ASSERT_EQ(connection.read_request({}), HttpConnection::ReadStatus::COMPLETE);
+    EXPECT_EQ(HttpRequest::parse_http_request(connection.take_request()).body, "Hello, world!");
+    ASSERT_EQ(connection.read_request({}), HttpConnection::ReadStatus::COMPLETE);
+    EXPECT_EQ(HttpRequest::parse_http_request(connection.take_request()).path, "/next");
+    writer.join();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(HttpConnectionTest, ReadsLargeContentLengthBody) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    const std::string request = generate_large_request_content_length(500 * 1024);
+    std::thread writer([&] { write(fds[0], request.c_str(), request.size()); });
+
+    HttpConnection connection{fds[1]};
+    ASSERT_EQ(connection.read_request({}), HttpConnection::ReadStatus::COMPLETE);
+    EXPECT_EQ(HttpRequest::parse_http_request(connection.take_request()).body.size(), 500 * 1024);
+    writer.join();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(HttpConnectionTest, RejectsOversizedRequestsBeforeBuffering) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    const std::string request = "POST /upload HTTP/1.1\r\nContent-Length: 1000000\r\n\r\n";
+    write(fds[0], request.c_str(), request.size());
+
+    HttpConnection connection{fds[1]};
+    EXPECT_EQ(connection.read_request({.max_body_size = 1024}), HttpConnection::ReadStatus::BODY_TOO_LARGE);
+
+    HttpConnection headers_connection{fds[1]};
+    const std::string long_header = "GET / HTTP/1.1\r\nX-Long: " + std::string(2048, 'a') + "\r\n\r\n";
+    write(fds[0], long_header.c_str(), long_header.size());
+    EXPECT_EQ(headers_connection.read_request({.max_header_size = 1024}),
+              HttpConnection::ReadStatus::HEADERS_TOO_LARGE);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(HttpTokenizerTest, AllImplementationsAgreeWithScalar) {
+    std::string text;
+    for (int i = 0; i < 300; ++i) {
+        text += static_cast<char>('a' + i * 7 % 26);
+        if (i % 37 == 0) {
+            text += ':';
+        }
+        if (i % 53 == 0) {
+            text += "\r\n";
+        }
+    }
+
+    const auto original = HttpTokenizer::implementation();
+    for (const auto impl: {HttpTokenizer::Implementation::SCALAR, HttpTokenizer::Implementation::SSE42,
+                           HttpTokenizer::Implementation::AVX2}) {
+        if (!HttpTokenizer::is_supported(impl)) {
+            continue;
+        }
+        HttpTokenizer::set_implementation(impl);
+        for (size_t pos = 0; pos <= text.size(); ++pos) {
+            EXPECT_EQ(HttpTokenizer::find_first_of(text, ":\n", pos), text.find_first_of(":\n", pos));
+            EXPECT_EQ(HttpTokenizer::find_first_of(text, "\n", pos), text.find('\n', pos));
+            EXPECT_EQ(HttpTokenizer::find_first_of(text, "#", pos), std::string::npos);
+        }
+        HttpRequest req = HttpRequest::parse_http_request(length_request);
+        EXPECT_EQ(req.path, "/test");
+        EXPECT_EQ(req.headers.at("content-length"), "13");
+        EXPECT_EQ(req.body, "Hello, world!");
+    }
+    HttpTokenizer::set_implementation(original);
+}
 
 TEST(BenchmarkHttpRequest, ParseContentLength10000) {
     constexpr int N = 10000;
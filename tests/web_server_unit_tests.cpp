@@ -1,6 +1,21 @@
 #include <gtest/gtest.h>
+#include <server/HttpCompression.hpp>
 #include <server/HttpRequest.hpp>
 #include <server/HttpResponse.hpp>
+#include <server/StaticAssetCache.hpp>
+#include <server/WSApplication.hpp>
+#include <server/WebSocket.hpp>
+#include <server/WebSocketDeflate.hpp>
+#include <server/WebSocketPayload.hpp>
+#include <algorithm>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <poll.h>
+#include <random>
+#include <sys/socket.h>
+#include <thread>
 
 TEST(HttpRequestTest, ParsesQueryParams) {
     std::string raw =
@@ -27,6 +42,60 @@ TEST(HttpRequestTest, DetectsWebSocketUpgrade) {
     EXPECT_EQ(req.get_websocket_key(), "abc123");
 }
 
+TEST(HttpRequestTest, ViewsOutliveSourceAndFollowCopies) {
+    HttpRequest copy;
+    {
+        std::string raw =
+            "POST /items?id=7 HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "X-Trace-Id: abc\r\n"
+            "\r\n"
+            "payload";
+        HttpRequest req = HttpRequest::parse_http_request(std::move(raw));
+        copy = req;
+    }
+    EXPECT_EQ(copy.path, "/items");
+    EXPECT_EQ(copy.version, "HTTP/1.1");
+    EXPECT_EQ(copy.query_params.at("id"), "7");
+    EXPECT_EQ(copy.headers.at("x-trace-id"), "abc");
+    EXPECT_EQ(copy.headers.at("HOST"), "localhost");
+    EXPECT_EQ(copy.body, "payload");
+    EXPECT_GE(copy.path.data(), copy.raw().data());
+    EXPECT_LE(copy.body.data() + copy.body.size(), copy.raw().data() + copy.raw().size());
+}
+
+TEST(HttpHeadersTest, LooksUpKnownAndCustomHeadersCaseInsensitively) {
+    HttpRequestHeaders headers;
+    headers.set("content-length", "5");
+    headers.set("X-Custom", "a");
+    headers.set("CONTENT-LENGTH", "6");
+    headers.set("x-custom", "b");
+
+    EXPECT_EQ(headers.size(), 2);
+    EXPECT_EQ(headers.at(HttpHeader::CONTENT_LENGTH), "6");
+    EXPECT_EQ(headers.at("Content-Length"), "6");
+    EXPECT_EQ(headers.at("X-CUSTOM"), "b");
+    EXPECT_FALSE(headers.contains(HttpHeader::HOST));
+    EXPECT_THROW((void)headers.at("missing"), std::out_of_range);
+}
+
+TEST(HttpHeadersTest, SpillsPastInlineCapacityAndKeepsSlots) {
+    BasicHttpHeaders<std::string, 2> headers;
+    headers.set(HttpHeader::HOST, "localhost");
+    for (int i = 0; i < 10; ++i) {
+        headers.set("X-Header-" + std::to_string(i), std::to_string(i));
+    }
+    headers.set("Upgrade", "websocket");
+    EXPECT_EQ(headers.size(), 12);
+    EXPECT_EQ(headers.at(HttpHeader::HOST), "localhost");
+    EXPECT_EQ(headers.at("x-header-9"), "9");
+
+    EXPECT_TRUE(headers.erase(HttpHeader::HOST));
+    EXPECT_FALSE(headers.contains("host"));
+    EXPECT_EQ(headers.at(HttpHeader::UPGRADE), "websocket");
+    EXPECT_EQ(headers.begin()->first, "X-Header-0");
+}
+
 TEST(HttpResponseTest, BuildsPlainTextResponse) {
     HttpResponse res = HttpResponse::Text("Hello", 200);
     std::string str = res.to_string();
@@ -41,3 +110,715 @@ TEST(HttpResponseTest, NotFoundResponseIncludesMessage) {
     EXPECT_EQ(res.body, "missing");
 }
 
+TEST(HttpResponseTest, FromFileKeepsFileOutOfMemory) {
+    const std::filesystem::path file_path = std::filesystem::temp_directory_path() / "lws_from_file_test.txt";
+    {
+        std::ofstream out(file_path, std::ios::binary);
+        out << "file contents";
+    }
+    HttpResponse res = HttpResponse::FromFile(file_path.string(), "text/plain");
+    ASSERT_TRUE(res.file_body.has_value());
+    EXPECT_TRUE(res.body.empty());
+    EXPECT_EQ(res.content_length(), 13);
+    EXPECT_NE(res.to_string().find("\r\n\r\nfile contents"), std::string::npos);
+    std::filesystem::remove(file_path);
+
+    EXPECT_EQ(HttpResponse::FromFile(file_path.string()).status_code, 404);
+}
+
+TEST(StaticAssetCacheTest, ServesFromMemoryUntilFileChanges) {
+    const std::filesystem::path base = std::filesystem::temp_directory_path() / "lws_static_cache_test";
+    std::filesystem::create_directories(base);
+    {
+        std::ofstream out(base / "app.js", std::ios::binary);
+        out << "first";
+    }
+    StaticAssetCache cache({.poll_timeout = 10});
+    const ServeStaticOptions options{.cache = &cache, .cache_control = {}};
+    HttpRequest req;
+    req.path = "/assets/app.js";
+
+    HttpResponse first = HttpResponse::ServeStatic(base, req, "/assets", options);
+    EXPECT_FALSE(first.file_body.has_value());
+    EXPECT_EQ(first.body_data(), "first");
+    EXPECT_NE(first.to_string().find("Content-Type: application/javascript\r\n"), std::string::npos);
+    EXPECT_EQ(cache.size(), 1);
+    EXPECT_EQ(HttpResponse::ServeStatic(base, req, "/assets", options).shared_body, first.shared_body);
+
+    {
+        std::ofstream out(base / "app.js", std::ios::binary | std::ios::trunc);
+        out << "second";
+    }
+    for (int i = 0; i < 200 && cache.size() > 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_EQ(HttpResponse::ServeStatic(base, req, "/assets", options).body_data(), "second");
+
+    std::filesystem::remove_all(base);
+}
+
+TEST(StaticAssetCacheTest, KeepsReassignedRequestKeysWhenTheOldAssetGoes) {
+    const std::filesystem::path base = std::filesystem::temp_directory_path() / "lws_static_cache_rekey_test";
+    std::filesystem::create_directories(base);
+    std::ofstream(base / "a.txt", std::ios::binary) << "a";
+    std::ofstream(base / "b.txt", std::ios::binary) << "b";
+    StaticAssetCache cache({.poll_timeout = 10});
+
+    ASSERT_NE(cache.load("key", base / "a.txt", "text/plain"), nullptr);
+    ASSERT_NE(cache.load("key", base / "b.txt", "text/plain"), nullptr);
+    cache.invalidate(base / "a.txt");
+    const auto asset = cache.find("key");
+    ASSERT_NE(asset, nullptr);
+    EXPECT_EQ(*asset->content, "b");
+
+    std::filesystem::remove_all(base);
+}
+
+TEST(HttpResponseTest, ServeStaticAnswersConditionalRequestsWithNotModified) {
+    const std::filesystem::path base = std::filesystem::temp_directory_path() / "lws_conditional_test";
+    std::filesystem::create_directories(base);
+    {
+        std::ofstream out(base / "style.css", std::ios::binary);
+        out << "body {}";
+    }
+    const ServeStaticOptions options{.cache_control = {{"/", "no-cache"}, {"/assets/", "max-age=3600"}}};
+    HttpRequest req;
+    req.method = HttpRequest::HttpMethod::HTTP_GET;
+    req.path = "/assets/style.css";
+
+    const HttpResponse full = HttpResponse::ServeStatic(base, req, "/assets", options);
+    ASSERT_EQ(full.status_code, 200);
+    ASSERT_TRUE(full.headers.contains(HttpHeader::ETAG));
+    ASSERT_TRUE(full.headers.contains(HttpHeader::LAST_MODIFIED));
+    EXPECT_EQ(full.headers.at(HttpHeader::CACHE_CONTROL), "max-age=3600");
+    const std::string etag = full.headers.at(HttpHeader::ETAG);
+
+    const std::string if_none_match = "\"other\", W/" + etag;
+    req.headers.set("If-None-Match", if_none_match);
+    const HttpResponse by_etag = HttpResponse::ServeStatic(base, req, "/assets", options);
+    EXPECT_EQ(by_etag.status_code, 304);
+    EXPECT_EQ(by_etag.to_string().find("Content-Length"), std::string::npos);
+    EXPECT_EQ(by_etag.headers.at(HttpHeader::CACHE_CONTROL), "max-age=3600");
+
+    req.headers.clear();
+    const std::string last_modified = full.headers.at(HttpHeader::LAST_MODIFIED);
+    req.headers.set("If-Modified-Since", last_modified);
+    EXPECT_EQ(HttpResponse::ServeStatic(base, req, "/assets", options).status_code, 304);
+    req.headers.set("If-Modified-Since", "Thu, 01 Jan 1970 00:00:00 GMT");
+    EXPECT_EQ(HttpResponse::ServeStatic(base, req, "/assets", options).status_code, 200);
+
+    std::filesystem::remove_all(base);
+}
+
+TEST(HttpResponseTest, AppliesSingleRangesAndIfRange) {
+    HttpResponse res = HttpResponse::Text("0123456789");
+    res.headers.set(HttpHeader::ETAG, "\"v1\"");
+    HttpRequest req;
+    req.method = HttpRequest::HttpMethod::HTTP_GET;
+    req.headers.set("Range", "bytes=3-5");
+
+    HttpResponse partial = res;
+    partial.apply_range(req);
+    EXPECT_EQ(partial.status_code, 206);
+    EXPECT_EQ(partial.headers.at(HttpHeader::CONTENT_RANGE), "bytes 3-5/10");
+    EXPECT_EQ(partial.body_data(), "345");
+
+    req.headers.set("If-Range", "\"v0\"");
+    HttpResponse stale = res;
+    stale.apply_range(req);
+    EXPECT_EQ(stale.status_code, 200);
+    EXPECT_EQ(stale.headers.at(HttpHeader::ACCEPT_RANGES), "bytes");
+
+    req.headers.clear();
+    req.headers.set("Range", "bytes=10-");
+    HttpResponse unsatisfiable = res;
+    unsatisfiable.apply_range(req);
+    EXPECT_EQ(unsatisfiable.status_code, 416);
+    EXPECT_EQ(unsatisfiable.headers.at(HttpHeader::CONTENT_RANGE), "bytes */10");
+}
+
+TEST(HttpCompressionTest, NegotiatesAcceptEncoding) {
+    EXPECT_TRUE(HttpCompression::accepts("gzip, deflate, br", "br"));
+    EXPECT_TRUE(HttpCompression::accepts("GZIP;q=1.0", "gzip"));
+    EXPECT_FALSE(HttpCompression::accepts("gzip, br;q=0", "br"));
+    EXPECT_TRUE(HttpCompression::accepts("identity, *;q=0.5", "gzip"));
+    EXPECT_FALSE(HttpCompression::accepts("identity", "gzip"));
+}
+
+TEST(HttpCompressionTest, GzipsLargeTextBodiesOnly) {
+    if (!HttpCompression::is_available()) {
+        GTEST_SKIP() << "built without zlib";
+    }
+    HttpRequest req;
+    req.headers.set("Accept-Encoding", "gzip");
+    const HttpCompression::Parameters params{.enabled = true, .min_size = 64};
+
+    HttpResponse small = HttpResponse::Json("{}");
+    EXPECT_FALSE(HttpCompression::compress(small, req, params));
+
+    HttpResponse large = HttpResponse::Json("[" + std::string(4096, '1') + "]");
+    ASSERT_TRUE(HttpCompression::compress(large, req, params));
+    EXPECT_EQ(large.headers.at(HttpHeader::CONTENT_ENCODING), "gzip");
+    EXPECT_EQ(large.headers.at(HttpHeader::VARY), "Accept-Encoding");
+    EXPECT_LT(large.body.size(), 4096);
+    EXPECT_EQ(large.body.substr(0, 2), "\x1f\x8b");
+
+    HttpRequest identity;
+    HttpResponse uncompressed = HttpResponse::Json("[" + std::string(4096, '1') + "]");
+    EXPECT_FALSE(HttpCompression::compress(uncompressed, identity, params));
+    EXPECT_EQ(uncompressed.headers.at(HttpHeader::VARY), "Accept-Encoding");
+}
+
+TEST(HttpResponseTest, ServeStaticPrefersAcceptedPrecompressedSidecar) {
+    const std::filesystem::path base = std::filesystem::temp_directory_path() / "lws_precompressed_test";
+    std::filesystem::create_directories(base);
+    std::ofstream(base / "app.js", std::ios::binary) << "plain";
+    std::ofstream(base / "app.js.gz", std::ios::binary) << "gzipped";
+    HttpRequest req;
+    req.method = HttpRequest::HttpMethod::HTTP_GET;
+    req.path = "/app.js";
+
+    const HttpResponse plain = HttpResponse::ServeStatic(base, req, "/");
+    EXPECT_FALSE(plain.headers.contains(HttpHeader::CONTENT_ENCODING));
+    EXPECT_EQ(plain.headers.at(HttpHeader::VARY), "Accept-Encoding");
+
+    req.headers.set("Accept-Encoding", "br, gzip");
+    const HttpResponse gzipped = HttpResponse::ServeStatic(base, req, "/");
+    EXPECT_EQ(gzipped.headers.at(HttpHeader::CONTENT_ENCODING), "gzip");
+    EXPECT_EQ(gzipped.headers.at(HttpHeader::CONTENT_TYPE), "application/javascript");
+    EXPECT_NE(gzipped.to_string().find("\r\n\r\ngzipped"), std::string::npos);
+    EXPECT_NE(gzipped.headers.at(HttpHeader::ETAG), plain.headers.at(HttpHeader::ETAG));
+
+    std::filesystem::remove_all(base);
+}
+
+TEST(StaticAssetCacheTest, KeysPrecompressedVariantsByTheCodingsTheClientAccepts) {
+    const std::filesystem::path base = std::filesystem::temp_directory_path() / "lws_precompressed_cache_test";
+    std::filesystem::create_directories(base);
+    std::ofstream(base / "app.js", std::ios::binary) << "plain";
+    std::ofstream(base / "app.js.gz", std::ios::binary) << "gzipped";
+    StaticAssetCache cache({.poll_timeout = 10});
+    const ServeStaticOptions options{.cache = &cache, .cache_control = {}};
+    HttpRequest req;
+    req.method = HttpRequest::HttpMethod::HTTP_GET;
+    req.path = "/app.js";
+
+    req.headers.set("Accept-Encoding", "br, gzip");
+    const HttpResponse gzipped = HttpResponse::ServeStatic(base, req, "/", options);
+    EXPECT_NE(gzipped.to_string().find("Content-Encoding: gzip\r\n"), std::string::npos);
+    EXPECT_EQ(gzipped.body_data(), "gzipped");
+
+    req.headers.set("Accept-Encoding", "br");
+    for (int i = 0; i < 2; ++i) {
+        const HttpResponse plain = HttpResponse::ServeStatic(base, req, "/", options);
+        EXPECT_EQ(plain.to_string().find("Content-Encoding"), std::string::npos);
+        EXPECT_EQ(plain.body_data(), "plain");
+    }
+
+    req.headers.set("Accept-Encoding", "br, gzip");
+    const HttpResponse cached = HttpResponse::ServeStatic(base, req, "/", options);
+    EXPECT_NE(cached.to_string().find("Content-Encoding: gzip\r\n"), std::string::npos);
+    EXPECT_EQ(cached.shared_body, gzipped.shared_body);
+
+    std::filesystem::remove_all(base);
+}
+
+static std::string client_frame(const uint8_t first_byte, const std::string &payload) {
+    const uint8_t key[4] = {0x12, 0x34, 0x56, 0x78};
+    std::string frame{static_cast<char>(first_byte)};
+    if (payload.size() < 126) {
+        frame += static_cast<char>(0x80 | payload.size());
+    } else {
+        frame += static_cast<char>(0x80 | 126);
+        frame += static_cast<char>(payload.size() >> 8);
+        frame += static_cast<char>(payload.size() & 0xFF);
+    }
+    frame.append(reinterpret_cast<const char *>(key), sizeof(key));
+    for (size_t i = 0; i < payload.size(); ++i) {
+        frame += static_cast<char>(payload[i] ^ key[i % 4]);
+    }
+    return frame;
+}
+
+TEST(WebSocketTest, DecodesFragmentedMessagesDeliveredByteByByte) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    WebSocket ws{fds[1]};
+
+    const std::string first(300, 'a');
+    const std::string stream = client_frame(0x01, first) + client_frame(0x89, "hi") + client_frame(0x80, "bc") +
+                               client_frame(0x82, std::string{"\0\1\2", 3});
+    std::string message;
+    WebSocket::OpCode opcode;
+    std::vector<std::pair<std::string, WebSocket::OpCode>> messages;
+    for (const char byte: stream) {
+        EXPECT_TRUE(ws.receive());
+        ASSERT_EQ(write(fds[0], &byte, 1), 1);
+        EXPECT_TRUE(ws.receive());
+        while (ws.next_message(message, opcode)) {
+            messages.emplace_back(message, opcode);
+        }
+    }
+
+    ASSERT_EQ(messages.size(), 2u);
+    EXPECT_EQ(messages[0].first, first + "bc");
+    EXPECT_EQ(messages[0].second, WebSocket::OpCode::TEXT);
+    EXPECT_EQ(messages[1].first, std::string("\0\1\2", 3));
+    EXPECT_EQ(messages[1].second, WebSocket::OpCode::BINARY);
+
+    // The interleaved ping was answered with an unmasked pong carrying its payload.
+    char pong[8] = {};
+    ASSERT_EQ(read(fds[0], pong, sizeof(pong)), 4);
+    EXPECT_EQ(std::string(pong, 4), "\x8A\x02hi");
+
+    const std::string close_frame = client_frame(0x88, "");
+    write(fds[0], close_frame.data(), close_frame.size());
+    EXPECT_TRUE(ws.receive());
+    ASSERT_TRUE(ws.next_message(message, opcode));
+    EXPECT_EQ(opcode, WebSocket::OpCode::CLOSE);
+
+    close(fds[0]);
+    EXPECT_FALSE(ws.receive());
+}
+
+TEST(WebSocketTest, SendsFramesWithNetworkOrderLengthsAndContinuations) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    WebSocket ws{fds[1]};
+
+    const std::string text(300, 't');
+    std::vector<std::byte> binary(40000);
+    for (size_t i = 0; i < binary.size(); ++i) {
+        binary[i] = static_cast<std::byte>(i);
+    }
+    ws.send(text, WebSocket::OpCode::TEXT);
+    ws.send(binary, WebSocket::OpCode::BINARY);
+    ws.send(std::span<const std::byte>{}, WebSocket::OpCode::BINARY);
+
+    const size_t expected = 4 + text.size() + 3 * 4 + binary.size() + 2;
+    std::string wire;
+    char buffer[16 * 1024];
+    while (wire.size() < expected) {
+        const ssize_t n = read(fds[0], buffer, sizeof(buffer));
+        ASSERT_GT(n, 0);
+        wire.append(buffer, n);
+    }
+    ASSERT_EQ(wire.size(), expected);
+
+    EXPECT_EQ(wire.substr(0, 4), std::string("\x81\x7E\x01\x2C", 4));
+    EXPECT_EQ(wire.substr(4, text.size()), text);
+    size_t pos = 4 + text.size();
+    std::string payload;
+    for (const auto &[first_byte, length]: {std::pair{0x02, 16384}, {0x00, 16384}, {0x80, 7232}}) {
+        EXPECT_EQ(static_cast<uint8_t>(wire[pos]), first_byte);
+        EXPECT_EQ(static_cast<uint8_t>(wire[pos + 1]), 126);
+        EXPECT_EQ((static_cast<uint8_t>(wire[pos + 2]) << 8) | static_cast<uint8_t>(wire[pos + 3]), length);
+        payload += wire.substr(pos + 4, length);
+        pos += 4 + length;
+    }
+    EXPECT_EQ(payload, std::string(reinterpret_cast<const char *>(binary.data()), binary.size()));
+    EXPECT_EQ(wire.substr(pos), std::string("\x82\x00", 2));
+
+    close(fds[0]);
+    EXPECT_THROW(ws.send("gone", WebSocket::OpCode::TEXT), std::runtime_error);
+}
+
+// Payloads of the unmasked, unfragmented server frames in `wire`.
+static std::vector<std::string> server_messages(const std::string &wire) {
+    std::vector<std::string> messages;
+    size_t pos = 0;
+    while (pos + 2 <= wire.size()) {
+        size_t length = static_cast<uint8_t>(wire[pos + 1]);
+        size_t header = 2;
+        if (length == 126) {
+            length = static_cast<uint8_t>(wire[pos + 2]) << 8 | static_cast<uint8_t>(wire[pos + 3]);
+            header = 4;
+        }
+        messages.push_back(wire.substr(pos + header, length));
+        pos += header + length;
+    }
+    return messages;
+}
+
+// Sends numbered 1000-byte messages to a peer that reads nothing until more than the high-water mark is queued,
+// then drains the socket and returns what the peer received.
+static std::vector<std::string> send_to_slow_consumer(const WebSocket::SlowConsumerPolicy policy,
+                                                      std::vector<WebSocket::SendStatus> &statuses) {
+    int fds[2];
+    EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    const int buffer_size = 4096;
+    setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+    WebSocket ws{fds[1], {.high_water_mark = 8 * 1024, .slow_consumer_policy = policy}};
+    std::vector<bool> interest;
+    ws.on_write_interest([&interest](const bool interested) { interest.push_back(interested); });
+
+    for (int i = 0; i < 200; ++i) {
+        std::string message = std::to_string(i);
+        message.resize(1000, '.');
+        statuses.push_back(ws.send(message, WebSocket::OpCode::TEXT));
+        EXPECT_LE(ws.buffered_amount(), 8 * 1024 + 1004);
+    }
+
+    std::string wire;
+    char buffer[4096];
+    for (;;) {
+        EXPECT_TRUE(ws.flush() || policy == WebSocket::SlowConsumerPolicy::DISCONNECT);
+        if (ws.buffered_amount() == 0 && policy != WebSocket::SlowConsumerPolicy::DISCONNECT) {
+            const ssize_t n = recv(fds[0], buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (n <= 0) {
+                break;
+            }
+            wire.append(buffer, n);
+            continue;
+        }
+        const ssize_t n = read(fds[0], buffer, sizeof(buffer));
+        if (n <= 0) {
+            break;
+        }
+        wire.append(buffer, n);
+    }
+    if (policy != WebSocket::SlowConsumerPolicy::DISCONNECT) {
+        EXPECT_EQ(interest, (std::vector<bool>{true, false}));
+    }
+    close(fds[0]);
+    return server_messages(wire);
+}
+
+TEST(WebSocketTest, QueuesForSlowConsumersAndAppliesThePolicyAtTheHighWaterMark) {
+    using Policy = WebSocket::SlowConsumerPolicy;
+    using Status = WebSocket::SendStatus;
+
+    std::vector<Status> statuses;
+    auto received = send_to_slow_consumer(Policy::DROP_NEWEST, statuses);
+    EXPECT_EQ(statuses.front(), Status::SENT);
+    ASSERT_NE(std::ranges::find(statuses, Status::QUEUED), statuses.end());
+    EXPECT_EQ(statuses.back(), Status::DROPPED);
+    ASSERT_EQ(received.size(), statuses.size() - std::ranges::count(statuses, Status::DROPPED));
+    for (size_t i = 0; i < received.size(); ++i) {
+        EXPECT_EQ(received[i].substr(0, received[i].find('.')), std::to_string(i));
+    }
+
+    statuses.clear();
+    received = send_to_slow_consumer(Policy::DROP_OLDEST, statuses);
+    EXPECT_EQ(std::ranges::count(statuses, Status::DROPPED), 0);
+    ASSERT_LT(received.size(), 200u);
+    EXPECT_EQ(received.back().substr(0, 3), "199");
+    for (const std::string &message: received) {
+        EXPECT_EQ(message.size(), 1000u);
+    }
+
+    statuses.clear();
+    received = send_to_slow_consumer(Policy::DISCONNECT, statuses);
+    const auto dropped = std::ranges::find(statuses, Status::DROPPED);
+    ASSERT_NE(dropped, statuses.end());
+    // Once shut down, further sends fail; everything sent before still reaches the peer.
+    EXPECT_LT(received.size(), 200u);
+}
+
+TEST(WSApplicationTest, PublishesOneEncodedFrameToTopicSubscribers) {
+    WSApplication app{{}};
+    std::vector<WebSocket *> connections;
+    app.on_open([&connections](WebSocket &ws) { connections.push_back(&ws); });
+    std::vector<int> peers;
+    for (int i = 0; i < 3; ++i) {
+        int fds[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        WebSocket ws{fds[1]};
+        app.add_connection(ws);
+        peers.push_back(fds[0]);
+    }
+    ASSERT_EQ(connections.size(), 3u);
+    for (WebSocket *ws: connections) {
+        app.subscribe(*ws, "room");
+    }
+    app.subscribe(*connections[0], "lobby");
+
+    EXPECT_EQ(app.publish("room", "hello", WebSocket::OpCode::TEXT, connections[1]), 2u);
+    app.unsubscribe(*connections[2], "room");
+    EXPECT_EQ(app.publish("room", "again"), 2u);
+    EXPECT_EQ(app.publish("lobby", "lobby only"), 1u);
+    EXPECT_EQ(app.publish("nobody", "lost"), 0u);
+
+    const std::vector<std::vector<std::string>> expected = {
+        {"hello", "again", "lobby only"}, {"again"}, {"hello"}};
+    for (size_t i = 0; i < peers.size(); ++i) {
+        char buffer[256];
+        const ssize_t n = recv(peers[i], buffer, sizeof(buffer), MSG_DONTWAIT);
+        ASSERT_GT(n, 0);
+        EXPECT_EQ(server_messages(std::string(buffer, n)), expected[i]);
+        close(peers[i]);
+    }
+}
+
+TEST(WebSocketDeflateTest, NegotiatesTheFirstAcceptableOffer) {
+    if (!HttpCompression::is_available()) {
+        GTEST_SKIP() << "built without zlib";
+    }
+    const WebSocketDeflate::Parameters parameters{.enabled = true, .max_memory = 1024 * 1024};
+    EXPECT_FALSE(WebSocketDeflate::negotiate("permessage-deflate", {}));
+    EXPECT_FALSE(WebSocketDeflate::negotiate("x-webkit-deflate-frame", parameters));
+    EXPECT_FALSE(WebSocketDeflate::negotiate("permessage-deflate; server_max_window_bits=8", parameters));
+
+    auto agreement = WebSocketDeflate::negotiate(
+        "permessage-deflate; mystery, permessage-deflate; client_max_window_bits; server_no_context_takeover",
+        parameters);
+    ASSERT_TRUE(agreement);
+    EXPECT_EQ(WebSocketDeflate::response_header(*agreement),
+              "permessage-deflate; server_no_context_takeover; client_max_window_bits=15");
+
+    agreement = WebSocketDeflate::negotiate(
+        R"(permessage-deflate; server_max_window_bits=10; client_max_window_bits="12")", parameters);
+    ASSERT_TRUE(agreement);
+    EXPECT_EQ(WebSocketDeflate::response_header(*agreement),
+              "permessage-deflate; server_max_window_bits=10; client_max_window_bits=12");
+
+    // Under the memory cap the windows and memLevel shrink; a client window that cannot be limited is fatal.
+    const WebSocketDeflate::Parameters capped{.enabled = true, .max_memory = 64 * 1024};
+    agreement = WebSocketDeflate::negotiate("permessage-deflate; client_max_window_bits", capped);
+    ASSERT_TRUE(agreement);
+    EXPECT_LE(WebSocketDeflate::estimated_memory(agreement->server_max_window_bits, agreement->client_max_window_bits,
+                                                 agreement->mem_level),
+              capped.max_memory);
+    EXPECT_FALSE(WebSocketDeflate::negotiate("permessage-deflate", {.enabled = true, .max_memory = 32 * 1024}));
+}
+
+TEST(WebSocketTest, ExchangesPermessageDeflateMessages) {
+    if (!HttpCompression::is_available()) {
+        GTEST_SKIP() << "built without zlib";
+    }
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    const WebSocketDeflate::Parameters parameters{.enabled = true, .min_size = 64};
+    WebSocket ws{fds[1], {.deflate = parameters}};
+    const std::string offer = "permessage-deflate; client_max_window_bits";
+    ASSERT_FALSE(ws.negotiate_extensions(offer).empty());
+
+    const std::string stroke =
+        R"({"type":"draw","fromX":120,"fromY":340,"toX":125,"toY":344,"color":"#ff0000","size":4})";
+    ws.send(stroke, WebSocket::OpCode::TEXT);
+    ws.send(stroke, WebSocket::OpCode::TEXT);
+    ws.send("short", WebSocket::OpCode::TEXT);
+
+    char buffer[1024];
+    const ssize_t n = read(fds[0], buffer, sizeof(buffer));
+    ASSERT_GT(n, 0);
+    const std::string wire(buffer, n);
+    const auto messages = server_messages(wire);
+    ASSERT_EQ(messages.size(), 3u);
+    EXPECT_EQ(static_cast<uint8_t>(wire[0]), 0xC1);
+    EXPECT_EQ(static_cast<uint8_t>(wire[2 + messages[0].size()]), 0xC1);
+    EXPECT_EQ(static_cast<uint8_t>(wire[4 + messages[0].size() + messages[1].size()]), 0x81);
+    // The second copy is mostly a back reference into the first.
+    EXPECT_LT(messages[1].size() * 5, stroke.size());
+
+    WebSocketDeflate client{*WebSocketDeflate::negotiate(offer, parameters), parameters};
+    EXPECT_EQ(client.decompress(messages[0], 1024), stroke);
+    EXPECT_EQ(client.decompress(messages[1], 1024), stroke);
+    EXPECT_EQ(messages[2], "short");
+
+    // A compressed client message, fragmented: RSV1 only on the first frame.
+    std::string compressed;
+    client.compress(stroke, compressed);
+    const std::string frames = client_frame(0x41, compressed.substr(0, 10)) + client_frame(0x80, compressed.substr(10));
+    write(fds[0], frames.data(), frames.size());
+    std::string message;
+    WebSocket::OpCode opcode;
+    ASSERT_TRUE(ws.receive());
+    ASSERT_TRUE(ws.next_message(message, opcode));
+    EXPECT_EQ(message, stroke);
+    EXPECT_EQ(opcode, WebSocket::OpCode::TEXT);
+
+    const std::string bad_continuation = client_frame(0x01, "a") + client_frame(0xC0, "b");
+    write(fds[0], bad_continuation.data(), bad_continuation.size());
+    ASSERT_TRUE(ws.receive());
+    EXPECT_THROW(ws.next_message(message, opcode), std::runtime_error);
+    close(fds[0]);
+}
+
+TEST(WSApplicationTest, ConnectionIdsGoStaleWhenTheirFdIsReused) {
+    WSApplication app{{.socket_listener = {.epoll_timeout = 10}}};
+    app.activate();
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    const int first_fd = fds[0];
+    WebSocket first{fds[0]};
+    const WSApplication::ConnectionId first_id = app.add_connection(first);
+    EXPECT_EQ(app.send(first_id, "hi", WebSocket::OpCode::TEXT), WebSocket::SendStatus::SENT);
+
+    // The listener vacates the slot and then closes the fd once it sees the hang-up.
+    close(fds[1]);
+    for (int i = 0; i < 500 && fcntl(first_fd, F_GETFD) != -1; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(fcntl(first_fd, F_GETFD), -1);
+    EXPECT_EQ(app.send(first_id, "hi", WebSocket::OpCode::TEXT), std::nullopt);
+
+    // The lowest free fd is handed out again, so the new connection lands in the same slot.
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ASSERT_EQ(fds[0], first_fd);
+    WebSocket second{fds[0]};
+    const WSApplication::ConnectionId second_id = app.add_connection(second);
+    EXPECT_NE(second_id, first_id);
+    EXPECT_EQ(static_cast<int>(second_id & 0xFFFFFFFF), first_fd);
+    EXPECT_EQ(app.send(first_id, "hi", WebSocket::OpCode::TEXT), std::nullopt);
+    EXPECT_EQ(app.send(second_id, "hi", WebSocket::OpCode::TEXT), WebSocket::SendStatus::SENT);
+
+    app.stop();
+    close(fds[1]);
+}
+
+TEST(WSApplicationTest, FlushesFramesTheOpenHandlerQueued) {
+    WSApplication app{{.socket_listener = {.epoll_timeout = 10}, .websocket = {.high_water_mark = 8 * 1024 * 1024}}};
+    const std::string payload(4 * 1024 * 1024, 'x');
+    app.on_open([&payload](WebSocket &ws) {
+        EXPECT_EQ(ws.send(payload, WebSocket::OpCode::BINARY), WebSocket::SendStatus::QUEUED);
+    });
+    app.activate();
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    WebSocket ws{fds[1]};
+    app.add_connection(ws);
+
+    // Only EPOLLOUT drains the queue: the peer never writes anything.
+    size_t received = 0;
+    char buffer[64 * 1024];
+    while (received < payload.size()) {
+        pollfd readable{fds[0], POLLIN, 0};
+        ASSERT_EQ(poll(&readable, 1, 5000), 1);
+        const ssize_t n = read(fds[0], buffer, sizeof(buffer));
+        ASSERT_GT(n, 0);
+        received += n;
+    }
+    app.stop();
+    close(fds[0]);
+}
+
+TEST(WSApplicationTest, RegistersConnectionsFromManyThreads) {
+    WSApplication app{{.socket_listener = {.epoll_timeout = 10}}};
+    app.activate();
+    constexpr int THREADS = 8;
+    constexpr int PER_THREAD = 32;
+    std::vector<std::vector<std::pair<WSApplication::ConnectionId, int>>> added(THREADS);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&app, &added, t] {
+            for (int i = 0; i < PER_THREAD; ++i) {
+                int fds[2];
+                ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+                WebSocket ws{fds[1]};
+                added[t].emplace_back(app.add_connection(ws), fds[0]);
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    for (const auto &connections: added) {
+        for (const auto &[id, peer]: connections) {
+            EXPECT_EQ(app.send(id, "x", WebSocket::OpCode::TEXT), WebSocket::SendStatus::SENT);
+            char frame[3];
+            EXPECT_EQ(read(peer, frame, sizeof(frame)), 3);
+            close(peer);
+        }
+    }
+    app.stop();
+}
+
+TEST(WebSocketTest, RejectsProtocolViolations) {
+    for (const std::string &frame: {client_frame(0x80, "orphan continuation"), client_frame(0xC1, "reserved bit"),
+                                    client_frame(0x09, "fragmented ping"), client_frame(0x83, "unknown opcode"),
+                                    client_frame(0x81, "bad \xC3\x28 text")}) {
+        int fds[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+        WebSocket ws{fds[1]};
+        write(fds[0], frame.data(), frame.size());
+        std::string message;
+        WebSocket::OpCode opcode;
+        ASSERT_TRUE(ws.receive());
+        EXPECT_THROW(ws.next_message(message, opcode), std::runtime_error);
+        close(fds[0]);
+    }
+}
+
+static std::vector<WebSocketPayload::Isa> supported_isas() {
+    std::vector<WebSocketPayload::Isa> isas;
+    for (const auto isa: {WebSocketPayload::Isa::SCALAR, WebSocketPayload::Isa::SSE2, WebSocketPayload::Isa::AVX2,
+                          WebSocketPayload::Isa::AVX512, WebSocketPayload::Isa::NEON}) {
+        if (WebSocketPayload::is_supported(isa)) {
+            isas.push_back(isa);
+        }
+    }
+    return isas;
+}
+
+TEST(WebSocketPayloadTest, UnmasksLikeTheBytewiseLoopOnEveryIsa) {
+    const uint8_t key[4] = {0xA1, 0x0B, 0x7C, 0xFF};
+    std::string payload(300, '\0');
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<char>(i * 7);
+    }
+    for (const auto isa: supported_isas()) {
+        for (size_t size = 0; size <= payload.size(); size += size < 140 ? 1 : 37) {
+            for (uint64_t offset = 0; offset < 4; ++offset) {
+                std::string data = payload.substr(0, size);
+                WebSocketPayload::unmask(isa, data.data(), data.size(), key, offset);
+                for (size_t i = 0; i < size; ++i) {
+                    ASSERT_EQ(static_cast<uint8_t>(data[i]), static_cast<uint8_t>(payload[i] ^ key[(offset + i) % 4]))
+                        << "isa " << static_cast<int>(isa) << " size " << size << " offset " << offset;
+                }
+            }
+        }
+    }
+}
+
+TEST(WebSocketPayloadTest, ValidatesUtf8OnEveryIsa) {
+    const std::vector<std::string> valid = {"", "plain ascii", "caf\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80",
+                                            "\xED\x9F\xBF", "\xEE\x80\x80", "\xF4\x8F\xBF\xBF"};
+    const std::vector<std::string> invalid = {"\x80", "\xC0\xAF", "\xC1\xBF", "\xE0\x9F\xBF", "\xED\xA0\x80",
+                                              "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80",
+                                              "\xC3", "\xE2\x82", "\xF0\x9F\x98", "\xC3\xA9\xA9", "\xFF"};
+    for (const auto isa: supported_isas()) {
+        // Place each case at every position around the 32 and 64 byte block boundaries.
+        for (size_t pad = 0; pad < 70; ++pad) {
+            const std::string prefix(pad, 'x');
+            for (const std::string &text: valid) {
+                EXPECT_TRUE(WebSocketPayload::is_valid_utf8(isa, prefix + text + "tail"))
+                    << "isa " << static_cast<int>(isa) << " pad " << pad;
+                EXPECT_TRUE(WebSocketPayload::is_valid_utf8(isa, prefix + text));
+            }
+            for (const std::string &text: invalid) {
+                EXPECT_FALSE(WebSocketPayload::is_valid_utf8(isa, prefix + text + "tail"))
+                    << "isa " << static_cast<int>(isa) << " pad " << pad;
+                EXPECT_FALSE(WebSocketPayload::is_valid_utf8(isa, prefix + text));
+            }
+        }
+    }
+}
+
+TEST(WebSocketPayloadTest, VectorUtf8ValidationAgreesWithScalarOnRandomInput) {
+    std::mt19937 rng(42);
+    const std::vector<std::string> pieces = {"a", "Z", " ", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80",
+                                             "\xED\x9F\xBF", "\xF4\x8F\xBF\xBF"};
+    for (int round = 0; round < 20000; ++round) {
+        std::string text;
+        const size_t count = rng() % 40;
+        for (size_t i = 0; i < count; ++i) {
+            text += pieces[rng() % pieces.size()];
+        }
+        // Corrupt some inputs with one arbitrary byte.
+        if (!text.empty() && rng() % 2 == 0) {
+            text[rng() % text.size()] = static_cast<char>(rng());
+        }
+        const bool expected = WebSocketPayload::is_valid_utf8(WebSocketPayload::Isa::SCALAR, text);
+        for (const auto isa: supported_isas()) {
+            ASSERT_EQ(WebSocketPayload::is_valid_utf8(isa, text), expected)
+                << "isa " << static_cast<int>(isa) << " round " << round;
+        }
+    }
+}